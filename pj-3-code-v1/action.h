@@ -29,6 +29,8 @@ public:
 		if (proto != entries().end()) return proto->second->reinterpret(this).apply(b);
 		return -1;
 	}
+	template<class board_type>
+	board::reward apply(board_type& b) const; // for the boards of other geometries, see below
 	virtual std::ostream& operator >>(std::ostream& out) const {
 		auto proto = entries().find(type());
 		if (proto != entries().end()) return proto->second->reinterpret(this) >> out;
@@ -45,6 +47,12 @@ public:
 
 public:
 	operator unsigned() const { return code; }
+
+	/**
+	 * the board height for flipping the row in SGF, which is stored in the stream
+	 * so that the actions of any board geometry can be printed and parsed
+	 */
+	static long& height(std::ios_base& s) { static const int index = std::ios_base::xalloc(); return s.iword(index); }
 	unsigned type() const { return code & type_flag(-1u); }
 	unsigned event() const { return code & ~type(); }
 	friend std::ostream& operator <<(std::ostream& out, const action& a) { return a >> out; }
@@ -67,13 +75,18 @@ public:
 	place(int x, int y, unsigned who) : place(board::point(x, y), who) {}
 	place(const board::point& p, unsigned who) : place(p.i, who) {}
 	place(const action& a = {}) : action(a) {}
-	board::point position() const { return board::point(int16_t(event() & 0xffff)); }
+	template<class board_type = board>
+	typename board_type::point position() const { return typename board_type::point(int16_t(event() & 0xffff)); }
 	board::piece_type color() const { return static_cast<board::piece_type>(event() >> 16); }
 public:
 	board::reward apply(board& b) const { return b.place(position(), color()); }
+	template<class board_type>
+	board::reward apply(board_type& b) const { return b.place(position<board_type>(), color()); }
 	std::ostream& operator >>(std::ostream& out) const {
-		return out << ';' << "?BW?"[color() & 0b11] << '[' << char('a' + position().x)
-		           << char('a' + ((board::size_y - 1) - position().y)) << ']';
+		int size_y = height(out) ?: board::size_y, i = int16_t(event() & 0xffff);
+		int x = i != -1 ? i / size_y : -1, y = i != -1 ? i % size_y : -1;
+		return out << ';' << "?BW?"[color() & 0b11] << '[' << char('a' + x)
+		           << char('a' + ((size_y - 1) - y)) << ']';
 	}
 	std::istream& operator <<(std::istream& in) {
 		while (isspace(in.peek()) && in.ignore(1));
@@ -82,9 +95,10 @@ public:
 			unsigned who = board::empty;
 			if (buf[1] == 'B') who = board::black;
 			if (buf[1] == 'W') who = board::white;
+			int size_y = height(in) ?: board::size_y;
 			int x = buf[3] - 'a';
-			int y = (board::size_y - 1) - (buf[4] - 'a');
-			operator=(place(x, y, who));
+			int y = (size_y - 1) - (buf[4] - 'a');
+			operator=(place(x * size_y + y, who));
 		} else {
 			in.setstate(std::ios::failbit);
 		}
@@ -118,3 +132,9 @@ protected:
 	action& reinterpret(const action* a) const { return *new (const_cast<action*>(a)) white(*a); }
 	static __attribute__((constructor)) void init() { entries()[type_flag('W')] = new white; }
 };
+
+template<class board_type>
+board::reward action::apply(board_type& b) const {
+	if (entries().find(type()) == entries().end()) return -1;
+	return action::place(*this).apply(b);
+}
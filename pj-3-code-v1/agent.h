@@ -12,15 +12,34 @@
 #include <random>
 #include <sstream>
 #include <map>
+#include <set>
 #include <atomic>
+#include <mutex>
 #include <type_traits>
 #include <algorithm>
 #include <fstream>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <cstring>
 #include <unistd.h>
-#include <omp.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "board.h"
 #include "action.h"
+#include "playout.h"
+#include "pattern.h"
+#include "safety.h"
+#include "region.h"
+#include "solver.h"
+#include "alphabeta.h"
+#include "threads.h"
+#include "rng.h"
+#include "network.h"
+#include "cluster.h"
 
+template<class board_type = board>
 class agent {
 public:
 	agent(const std::string& args = "") {
@@ -30,12 +49,20 @@ public:
 			std::string value = pair.substr(pair.find('=') + 1);
 			meta[key] = { value };
 		}
+		if (meta.find("config") != meta.end()) { // the options saved in a file, e.g., by the tuner, unless given explicitly
+			std::ifstream in(meta["config"].value);
+			if (!in.is_open()) throw std::invalid_argument("cannot open config file: " + meta["config"].value);
+			for (std::string pair; in >> pair; ) {
+				std::string key = pair.substr(0, pair.find('='));
+				if (meta.find(key) == meta.end()) meta[key] = { pair.substr(pair.find('=') + 1) };
+			}
+		}
 	}
 	virtual ~agent() {}
 	virtual void open_episode(const std::string& flag = "") {}
 	virtual void close_episode(const std::string& flag = "") {}
-	virtual action take_action(const board& b) { return action(); }
-	virtual bool check_for_win(const board& b) { return false; }
+	virtual action take_action(const board_type& b) { return action(); }
+	virtual bool check_for_win(const board_type& b) { return false; }
 
 public:
 	virtual std::string property(const std::string& key) const { return meta.at(key); }
@@ -56,108 +83,220 @@ protected:
 
 /**
  * base agent for agents with randomness
+ * the engine is seeded by option seed, or by 0 with deterministic=1, or randomly otherwise
  */
-class random_agent : public agent {
+template<class board_type = board>
+class random_agent : public agent<board_type> {
 public:
-	random_agent(const std::string& args = "") : agent(args) {
+	random_agent(const std::string& args = "") : agent<board_type>(args) {
+		if (meta.find("deterministic") != meta.end())
+			deterministic = (int)meta["deterministic"];
 		if (meta.find("seed") != meta.end())
-			engine.seed(int(meta["seed"]));
+			engine.seed((unsigned long long)meta["seed"]);
+		else if (!deterministic)
+			engine.seed(uint64_t(std::random_device()()) << 32 | std::random_device()());
 	}
 	virtual ~random_agent() {}
 
 protected:
-	std::default_random_engine engine;
+	using agent<board_type>::meta;
+	xoshiro256 engine;
+	bool deterministic = false;
 };
 
 /**
  * random player for both side
  * put a legal piece randomly
  */
-
-class Node {
+template<class board_type = board>
+class player : public random_agent<board_type> {
 public:
-        board state;
-        int win_count = 0;
-        int visit_count = 0;
-        double UCT_value = 0x3f3f3f3f;
-        Node* parent = nullptr;
-        action::place last_action;
-        std::vector<Node*> children;
-        board::piece_type who;
-
-	~Node(){};
-};
+	class Node {
+	public:
+	        board_type state;
+	        int win_count = 0;
+	        int visit_count = 0;
+	        double UCT_value = 0x3f3f3f3f;
+	        Node* parent = nullptr;
+	        action::place last_action;
+	        std::vector<Node*> children;
+	        board::piece_type who;
+	        board::piece_type proven = board::empty; /* the winner if the node is proven, see option solve */
+
+		~Node(){};
+	};
+
+	/**
+	 * the pool of tree nodes, where the released nodes are kept in a free list for reuse
+	 * the pools of a player share the node budget, which limits the nodes ever created (live or free)
+	 * each pool is used by only one thread at a time
+	 */
+	class node_pool {
+	public:
+		node_pool(player& owner) : owner(owner) {}
+		node_pool(const node_pool&) = delete;
+		~node_pool() { for (Node* node : free_list) delete node; }
+
+		/* make sure that n nodes can be allocated without exceeding the budget, unless forced */
+		bool reserve(size_t n, bool force = false) {
+			if (free_list.size() >= n) return true;
+			size_t need = n - free_list.size();
+			size_t created = owner.node_created.fetch_add(need) + need;
+			if (owner.node_budget && created > owner.node_budget && !force) {
+				owner.node_created -= need;
+				return false;
+			}
+			for (size_t i = 0; i < need; i++) free_list.push_back(new Node);
+			return true;
+		}
+		Node* alloc() {
+			if (free_list.empty()) reserve(1, true);
+			Node* node = free_list.back();
+			free_list.pop_back();
+			size_t live = ++owner.node_live;
+			for (size_t peak = owner.node_peak; live > peak && !owner.node_peak.compare_exchange_weak(peak, live); );
+			return node;
+		}
+		void release(Node* node) {
+			node->win_count = 0;
+			node->visit_count = 0;
+			node->UCT_value = 0x3f3f3f3f;
+			node->parent = nullptr;
+			node->proven = board::empty;
+			node->children.clear();
+			free_list.push_back(node);
+			--owner.node_live;
+		}
+		size_t available() const {
+			size_t created = owner.node_created;
+			if (owner.node_budget == 0) return -1ull;
+			return free_list.size() + (owner.node_budget > created ? owner.node_budget - created : 0);
+		}
+
+	private:
+		player& owner;
+		std::vector<Node*> free_list;
+	};
 
-class player : public random_agent {
 public:
-	player(const std::string& args = "") : random_agent("name=random role=unknown " + args),
-		space(board::size_x * board::size_y),
-	        white_space(board::size_x * board::size_y),
-		black_space(board::size_x * board::size_y),
+	player(const std::string& args = "") : random_agent<board_type>("name=random role=unknown " + args),
+		space(board_type::size_n),
+	        white_space(board_type::size_n),
+		black_space(board_type::size_n),
 		who(board::empty) {
-		if (name().find_first_of("[]():; ") != std::string::npos)
-			throw std::invalid_argument("invalid name: " + name());
+		if (this->name().find_first_of("[]():; ") != std::string::npos)
+			throw std::invalid_argument("invalid name: " + this->name());
 		if (meta.find("search") != meta.end()) action_mode = (std::string)meta["search"];
 		if (meta.find("timeout") != meta.end()) timeout = (clock_t)meta["timeout"];
 		if (meta.find("simulation") != meta.end()) simulation_count = (int)meta["simulation"];
 		if (meta.find("thread") != meta.end()) thread_num = (int)meta["thread"];
+		if (meta.find("batch") != meta.end()) batch_size = std::max((int)meta["batch"], 1);
+		if (meta.find("memory") != meta.end()) node_budget = (double)meta["memory"] * 1048576 / (sizeof(Node) + sizeof(Node*));
+		if (meta.find("prune") != meta.end()) prune = (int)meta["prune"];
+		if (meta.find("rollout") != meta.end()) rollout = (std::string)meta["rollout"];
+		if (meta.find("pattern") != meta.end()) patterns.load(meta["pattern"]), rollout = "pattern";
+		if (rollout != "random" && rollout != "pattern")
+			throw std::invalid_argument("invalid rollout: " + rollout);
+		if (meta.find("safe") != meta.end()) safe = (int)meta["safe"];
+		if (meta.find("region") != meta.end()) regions.set_limit((int)meta["region"]), use_region = true;
+		if (meta.find("region_nodes") != meta.end()) regions.set_budget((size_t)meta["region_nodes"]);
+		if (meta.find("solve") != meta.end()) solve_budget = (size_t)meta["solve"];
+		solve_move = (meta.find("solve_move") != meta.end() ? (size_t)meta["solve_move"] : solve_budget * 4);
+		if (meta.find("nodes") != meta.end()) proof_budget = (size_t)meta["nodes"];
+		if (meta.find("depth") != meta.end()) search_depth = (int)meta["depth"];
+		if (meta.find("pin") != meta.end()) pin = (int)meta["pin"];
+		if (meta.find("uct") != meta.end()) explore = (double)meta["uct"];
+		if (meta.find("dynamic") != meta.end()) dynamic = (int)meta["dynamic"];
+		if (meta.find("share") != meta.end()) share_interval = (int)meta["share"];
+		if (meta.find("gumbel") != meta.end()) gumbel = (int)meta["gumbel"];
+		if (meta.find("net") != meta.end()) net.load(meta["net"]);
+		if (meta.find("mix") != meta.end()) mix = std::min(std::max((double)meta["mix"], 0.0), 1.0);
+		if (meta.find("schedule") != meta.end()) { // the 36 time slices separated by commas
+			std::stringstream in(meta["schedule"].value);
+			size_t n = 0;
+			for (std::string slice; std::getline(in, slice, ','); n++)
+				if (n < 36) time_schedule[n] = std::stod(slice);
+			if (n != 36) throw std::invalid_argument("invalid schedule: " + meta["schedule"].value);
+		}
 		if (timeout != 0 and simulation_count != 0) std::cout << "use simulation args\n";
-		if (role() == "black") who = board::black;
-		if (role() == "white") who = board::white;
+		if (this->role() == "black") who = board::black;
+		if (this->role() == "white") who = board::white;
 		if (who == board::empty)
-			throw std::invalid_argument("invalid role: " + role());
+			throw std::invalid_argument("invalid role: " + this->role());
 		for (size_t i = 0; i < space.size(); i++)
 			space[i] = action::place(i, who);
 		for (size_t i = 0; i < white_space.size(); ++i)
 			white_space[i] = action::place(i, board::white);
 		for (size_t i = 0; i < black_space.size(); ++i)
 			black_space[i] = action::place(i, board::black);
+		solvers.resize(std::max(thread_num, 1) + 1);
+		if (action_mode == "MCTS-parallel" || action_mode == "alpha-beta")
+			workers.reset(new thread_pool(thread_num, pin));
+		if (meta.find("cluster") != meta.end() && (int)meta["cluster"] > 0) {
+			if (action_mode != "MCTS") throw std::invalid_argument("cluster requires search=MCTS");
+			size_t megabytes = (meta.find("table") != meta.end() ? (size_t)meta["table"] : 64);
+			int grace = (meta.find("grace") != meta.end() ? (int)meta["grace"] : 1000);
+			cluster.reset(new search_cluster<board_type>((int)meta["cluster"], cluster_config(), megabytes, grace));
+			table = &cluster->table();
+		}
 	}
 	/******************* begin of MCTS's tools **************************/
 	void computeUCT(Node* node, int total_visit_count) {
 		int visit_cnt = node->visit_count;
-		node->UCT_value = ((double)node->win_count/visit_cnt) + 0.5*sqrt(log((double)total_visit_count)/visit_cnt);
+		node->UCT_value = ((double)node->win_count/visit_cnt) + explore*sqrt(log((double)total_visit_count)/visit_cnt);
+		/* a proven node is always chosen if it wins for the side choosing it, and never otherwise */
+		if (node->proven != board::empty)
+			node->UCT_value = (node->proven == node->who ? 0x3f3f3f3f : -1);
 	}
 	
-	void expension(Node* parent_node) {
-		board::piece_type child_who;
-		action::place child_move;
+	/* return false if the node budget is exhausted, the root should be forced to expand */
+	bool expension(Node* parent_node, bool force = false) {
+		probe::count(probe::expansion);
+		node_pool& pool = *pools[thread_pool::index()];
+		
+		int empty_space = 0; /* the upper bound of the children */
+		for (int i = 0; i < board_type::size_n; ++i)
+			empty_space += (parent_node->state(i) == board::empty);
+		if (pool.reserve(empty_space, force) == false)
+			return false;
 	 		
-		if (parent_node->who == board::black) {
-			child_who = board::white;
-			for(const action::place& child_move : white_space) {
-				board after = parent_node->state;
-				if (child_move.apply(after) == board::legal) {
-					Node* child_node = new Node;
-					child_node->state = after;
-					child_node->parent = parent_node;
-					child_node->last_action = child_move;
-					child_node->who = child_who;
-					
-					parent_node->children.emplace_back(child_node);
-				}
-			}
-		}
-		else if (parent_node->who == board::white) {
-			child_who = board::black;
-			for(const action::place& child_move : black_space) {
-				board after = parent_node->state;
-				if (child_move.apply(after) == board::legal) {
-					Node* child_node = new Node;
-					child_node->state = after;
-					child_node->parent = parent_node;
-					child_node->last_action = child_move;
-					child_node->who = child_who;
-					
-					parent_node->children.emplace_back(child_node);
-				}
+		safe_points<board_type> safety;
+		if (safe) safety.reset(parent_node->state);
+		
+		/* with the safe-point analysis, the illegal moves are skipped without trying,
+		// and the moves filling own eyes are expanded only if there is no other legal move, see settle */
+		for (int pass = 0; pass < (safe ? 2 : 1) && parent_node->children.empty(); ++pass)
+			grow(parent_node, pool, safety, pass == 1);
+		probe::count(probe::expansion_child, parent_node->children.size());
+		return true;
+	}
+	
+	/* add the children of the legal moves, which fill own eyes if wasted is set, or do not otherwise (only with safe) */
+	void grow(Node* parent_node, node_pool& pool, const safe_points<board_type>& safety, bool wasted) {
+		board::piece_type child_who = (parent_node->who == board::black ? board::white : board::black);
+		const std::vector<action::place>& moves = (child_who == board::white ? white_space : black_space);
+		for(const action::place& child_move : moves) {
+			int i = child_move.template position<board_type>().i;
+			if (safe && (safety(i, child_who) == safety.illegal || safety.wasted(i, child_who) != wasted))
+				continue;
+			board_type after = parent_node->state;
+			if (child_move.apply(after) == board::legal) {
+				Node* child_node = pool.alloc();
+				child_node->state = after;
+				child_node->parent = parent_node;
+				child_node->last_action = child_move;
+				child_node->who = child_who;
+				
+				parent_node->children.emplace_back(child_node);
 			}
 		}
-			
 	}
 	
 	Node* selection(Node* node) {
-		while(node->children.empty() == false) {
+		probe::scope timing(probe::in_selection);
+		probe::count(probe::selection);
+		while(node->children.empty() == false && node->proven == board::empty) {
+			probe::count(probe::selection_depth);
 			double max_UCT_value = 0;
 			int select_idx = 0;
 			int bound = node->children.size();
@@ -173,80 +312,117 @@ public:
 	}
 	
 	/* return the winner */
-	board::piece_type simulation(Node* root, bool random_open = false) {
-		bool terminal = false;
-		board state = root->state;
+	template<class random_engine>
+	board::piece_type simulation(Node* root, random_engine& engine) {
+		probe::scope timing(probe::in_simulation);
+		board_type state = root->state;
 		board::piece_type who = root->who;
 		
-		if(random_open == true) {
-			std::default_random_engine engine2(time(0) + omp_get_thread_num());
-			engine = engine2;
+		if (root->proven != board::empty) /* no playout is required for a proven node */
+			return root->proven;
+		
+		if (use_region) { /* no playout is required if the regions decide the winner */
+			board::piece_type proven = regions.decided(state, (who == board::white ? board::black : board::white));
+			if (proven != board::empty)
+				return proven;
 		}
 		
-		while(terminal == false) {
-			/* there are no legal move -> terminal */
-			terminal = true;
-			
+		if (net.empty() == false) { /* the value of the network instead of the playout, with the probability of option mix */
+			board::piece_type tomove = (who == board::white ? board::black : board::white);
+			board::piece_type judged = judge(tomove, evaluate(root), engine);
+			if (judged != board::empty)
+				return judged;
+		}
+		
+		if (rollout == "pattern")
+			return pattern_rollout.run(state, (who == board::white ? board::black : board::white), engine, safe >= 2);
+		
+		safe_points<board_type> safety;
+		if (safe >= 2) safety.reset(state);
+		probe::count(probe::rollout);
+		
+		/* the points not yet known to be illegal for black and white, since an illegal move remains illegal,
+		// a point drawn and found illegal is removed for good, which gives the uniformly random legal move */
+		std::vector<int> candidates[2];
+		for (int i = 0; i < board_type::size_n; ++i) {
+			if (state(i) != board::empty) continue;
+			candidates[0].push_back(i);
+			candidates[1].push_back(i);
+		}
+		
+		while(true) {
 			/*rival's round*/
 			who = (who == board::white ? board::black : board::white);
 			
-			if (who == board::black) {
-				/* place randomly , apply the first legal move*/
-				std::vector<action::place> temp_black(black_space);
-				std::shuffle(temp_black.begin(), temp_black.end(), engine);
-
-				std::vector<action::place>::iterator it = temp_black.begin();
-				std::atomic<bool> flag(true);
-				while (it != temp_black.end() && flag) {
-					board after = state;
-					action::place move = *it;
-					if(move.apply(after) == board::legal) {
-						//std::cout << move << "\n";
-						move.apply(state);
-						terminal = false;
-						flag = false;
-					}
-					++it;
-				}
-				
-			}
-				
-			if (who == board::white) {
-				/* place randomly , apply the first legal move*/
-				std::vector<action::place> temp_white(white_space);
-				std::shuffle(temp_white.begin(), temp_white.end(), engine);
-
-				std::vector<action::place>::iterator it = temp_white.begin();
-				std::atomic<bool> flag(true);
-				while (it != temp_white.end() && flag) {
-					board after = state;
-					action::place move = *it;
-					if(move.apply(after) == board::legal) {
-						//std::cout << move << "\n";
-						move.apply(state);
-						terminal = false;
-						flag = false;
-					}
-					++it;
+			/* stop early once the bounds of the remaining moves decide the winner */
+			board::piece_type decided = (safe >= 2 ? safety.decided(who) : board::empty);
+			if (decided != board::empty)
+				return decided;
+			
+			std::vector<int>& moves = candidates[who - 1];
+			bool terminal = true;
+			while (moves.empty() == false) {
+				size_t k = engine.bounded(moves.size());
+				int i = moves[k];
+				moves[k] = moves.back();
+				moves.pop_back();
+				if (safe >= 2 && !safety.legal_points(who)[i]) continue;
+				if (state.place(typename board_type::point(i), who) == board::legal) { /* an illegal move leaves the state unchanged */
+					if (safe >= 2) safety.update(state, i);
+					probe::count(probe::rollout_move);
+					terminal = false;
+					break;
 				}
 			}
 			
+			/*I have no legal move, rival win*/
+			if (terminal)
+				return (who == board::white ? board::black : board::white);
 		}
-		
-		/*I have no legal move, rival win*/
-		return (who == board::white ? board::black : board::white);
 	}
 	
-	void backpropagation(Node* root, Node* node, board::piece_type winner, int total_visit_count) {
+	/* order the children by the priors, so that the unvisited ones are tried in this order, see selection */
+	void arrange(Node* node, const float* policy) {
+		std::stable_sort(node->children.begin(), node->children.end(), [&](const Node* a, const Node* b) {
+			return policy[a->last_action.template position<board_type>().i] > policy[b->last_action.template position<board_type>().i];
+		});
+	}
+	
+	/* evaluate the node by the network, order its children by the priors, and return the value of the side to move */
+	float evaluate(Node* node) {
+		const board_type* states[] = { &node->state };
+		board::piece_type tomove = (node->who == board::white ? board::black : board::white);
+		float value, policy[board_type::size_n];
+		net.evaluate(states, &tomove, 1, &value, policy);
+		arrange(node, policy);
+		return value;
+	}
+	
+	/* the winner drawn by the value of the side to move, or empty for a playout instead, see option mix */
+	template<class random_engine>
+	board::piece_type judge(board::piece_type tomove, float value, random_engine& engine) {
+		const uint32_t one = 1 << 24;
+		if (mix < 1 && engine.bounded(one) >= mix * one)
+			return board::empty;
+		return engine.bounded(one) < value * one ? tomove : (tomove == board::white ? board::black : board::white);
+	}
+	
+	/* visited == true indicates that the visits are already counted, see batch_search */
+	void backpropagation(Node* root, Node* node, board::piece_type winner, int total_visit_count, bool visited = false) {
 		/* e.g.
 		// root state : last_action = white 
 		// -> root who = black 
 		*/
+		probe::scope timing(probe::in_backpropagation);
+		probe::count(probe::backpropagation);
 		bool win = true;
 		if(winner == root->who)
 			win = false;
 		while(node != nullptr) {
-			++node->visit_count;
+			if (solve_budget)
+				settle(node);
+			if(visited == false)
+				++node->visit_count;
 			if(win == true)
 				++node->win_count;
 			computeUCT(node, total_visit_count);
@@ -254,34 +430,664 @@ public:
 		}
 	}
 	
+	/* select a batch of leaves with virtual loss, and evaluate them by the batched playouts */
+	template<class random_engine>
+	void batch_search(Node* root, int& total_visit_count, random_engine& engine) {
+		std::vector<Node*> leaves(batch_size);
+		std::vector<const board_type*> states(batch_size);
+		std::vector<board::piece_type> tomove(batch_size), winner(batch_size);
+		
+		for(int k = 0; k < batch_size; ++k) {
+			if (k == 0) maintain(root);
+			leaves[k] = selection(root);
+			if (expension(leaves[k]))
+				prove(leaves[k]);
+			/* count the visit in advance, so that the next selection prefers other paths */
+			for(Node* node = leaves[k]; node != nullptr; node = node->parent) {
+				++node->visit_count;
+				computeUCT(node, total_visit_count + k + 1);
+			}
+			states[k] = &leaves[k]->state;
+			tomove[k] = (leaves[k]->who == board::white ? board::black : board::white);
+		}
+		
+		if (net.empty() == false) { /* the values of the leaves in one batch of the network, and the playouts for the rest */
+			const int n = board_type::size_n;
+			std::vector<float> value(batch_size), policy(batch_size * n);
+			net.evaluate(states.data(), tomove.data(), batch_size, value.data(), policy.data());
+			std::vector<int> rest;
+			for(int k = 0; k < batch_size; ++k) {
+				arrange(leaves[k], &policy[k * n]);
+				winner[k] = judge(tomove[k], value[k], engine);
+				if (winner[k] == board::empty) {
+					states[rest.size()] = states[k], tomove[rest.size()] = tomove[k];
+					rest.push_back(k);
+				}
+			}
+			std::vector<board::piece_type> outcome(rest.size());
+			playout.run(states.data(), tomove.data(), outcome.data(), rest.size(), engine);
+			for(size_t r = 0; r < rest.size(); ++r)
+				winner[rest[r]] = outcome[r];
+		}
+		else
+			playout.run(states.data(), tomove.data(), winner.data(), batch_size, engine);
+		
+		for(int k = 0; k < batch_size; ++k) {
+			if (leaves[k]->proven != board::empty)
+				winner[k] = leaves[k]->proven;
+			++total_visit_count;
+			backpropagation(root, leaves[k], winner[k], total_visit_count, true);
+		}
+	}
+	
 	action bestAction(Node* node) {
 		int child_idx = -1;
-		int max_visit_count = 0;
+		int max_visit_count = -1; /* a legal move is played even if unvisited, e.g., after an immediate stop */
 		
-		for(size_t i = 0; i < node->children.size(); ++i) {
-			//std::cout << "id " << i << " " << node->children[i]->visit_count << "\n";	
-			if(node->children[i]->visit_count > max_visit_count) {
-				max_visit_count = node->children[i]->visit_count;
-				child_idx = i;
+		/* play a proven win, and avoid the proven losses unless all moves lose */
+		for(Node* child : node->children)
+			if(child->proven == child->who) return child->last_action;
+		for(int avoid = 1; avoid >= 0 && child_idx == -1; --avoid) {
+			for(size_t i = 0; i < node->children.size(); ++i) {
+				//std::cout << "id " << i << " " << node->children[i]->visit_count << "\n";	
+				if(avoid && node->children[i]->proven != board::empty && node->proven == board::empty) continue;
+				if(node->children[i]->visit_count > max_visit_count) {
+					max_visit_count = node->children[i]->visit_count;
+					child_idx = i;
+				}
 			}
 		}
 		//std::cout << "\n";
-		if(child_idx == -1) return action();
+		if(child_idx == -1) return action(); /* no legal move */
 		return node->children[child_idx]->last_action;
 	}
 	
 	void delete_tree(Node* node) {
 		if(node->children.empty() == false) {
+			node_pool& pool = *pools[thread_pool::index()];
 			for(size_t i = 0; i < node->children.size(); ++i) {
 				delete_tree(node->children[i]);
 				if(node->children[i] != nullptr)
-					free(node->children[i]);
+					pool.release(node->children[i]);
 			}
 			node->children.clear();
 		}
 	}
+	
+	/**
+	 * the statistics shared by the root-parallel trees of MCTS-parallel (option share), where each tree publishes
+	 * the visits and wins of its own simulations at the root children and grandchildren, and imports the ones of
+	 * the other trees, so that all trees focus on the moves promising to the whole group; the nodes are keyed by
+	 * their moves instead of their positions in the children, since the trees grow in different shapes
+	 */
+	struct shared_stats {
+		struct record {
+			int visits = 0, wins = 0;
+		};
+		std::mutex mtx;
+		std::vector<record> total;                            /* of all trees, indexed by the key */
+		std::vector<std::vector<record>> published, imported; /* of each tree, indexed by the key */
+		std::vector<int> extra;                               /* the root visits imported to each tree */
+		shared_stats(int trees) : total(key_space()), published(trees, total), imported(trees, total), extra(trees, 0) {}
+		/* the key of a child (move) or a grandchild (move, reply) of the root */
+		static int key_space() { return board_type::size_n * (board_type::size_n + 1); }
+		static int key(int move, int reply = -1) { return reply < 0 ? move : board_type::size_n * (move + 1) + reply; }
+	};
+
+	/* exchange the statistics of the tree i with the shared ones, see shared_stats */
+	void share(Node* root, int i, int visits, shared_stats& shared) {
+		std::lock_guard<std::mutex> lock(shared.mtx);
+		auto sync = [&](Node* node, int key) {
+			typename shared_stats::record& out = shared.published[i][key], &in = shared.imported[i][key], &all = shared.total[key];
+			int own = node->visit_count - in.visits, own_wins = node->win_count - in.wins;
+			all.visits += own - out.visits, all.wins += own_wins - out.wins;
+			out.visits = own, out.wins = own_wins;
+			int add = all.visits - own - in.visits, add_wins = all.wins - own_wins - in.wins;
+			node->visit_count += add, node->win_count += add_wins;
+			in.visits += add, in.wins += add_wins;
+			return add;
+		};
+		auto move = [](Node* node) { return node->last_action.template position<board_type>().i; };
+		int added = 0;
+		for (Node* child : root->children) {
+			added += sync(child, shared_stats::key(move(child)));
+			if (prune) continue; // the grandchildren may be pruned and regrown, so only the children are shared
+			for (Node* grandchild : child->children)
+				sync(grandchild, shared_stats::key(move(child), move(grandchild)));
+		}
+		root->visit_count += added;
+		shared.extra[i] += added;
+		for (Node* child : root->children) {
+			if (child->visit_count) computeUCT(child, visits + shared.extra[i]);
+			for (Node* grandchild : child->children)
+				if (grandchild->visit_count) computeUCT(grandchild, visits + shared.extra[i]);
+		}
+	}
+
+	/**
+	 * exchange the statistics of the children and the grandchildren of the root with the table of the cluster,
+	 * as share but across the processes, where the positions are keyed by their hashes; each process publishes its
+	 * own visits and wins, and imports the rest of the table, which are subtracted again by collect_cluster
+	 */
+	void exchange(Node* root, int& total_visit_count) {
+		if (total_visit_count - exchanged_at < (share_interval ? share_interval : 256)) return;
+		auto sync = [&](Node* node) {
+			uint64_t key = table_key(node);
+			typename shared_stats::record& out = exchanged[key].first, &in = exchanged[key].second;
+			int own = node->visit_count - in.visits, own_wins = node->win_count - in.wins;
+			if ((own != out.visits || own_wins != out.wins) && table->add(key, own - out.visits, own_wins - out.wins))
+				out.visits = own, out.wins = own_wins;
+			int visits = 0, wins = 0;
+			if (table->get(key, visits, wins) == false) return 0;
+			int add = visits - own - in.visits, add_wins = wins - own_wins - in.wins;
+			if (add <= 0) return 0; // the table may be cleared by the coordinator
+			node->visit_count += add, node->win_count += add_wins;
+			in.visits += add, in.wins += add_wins;
+			return add;
+		};
+		int added = 0;
+		for (Node* child : root->children) {
+			added += sync(child);
+			if (prune) continue; // the grandchildren may be pruned and regrown, so only the children are shared
+			for (Node* grandchild : child->children) sync(grandchild);
+		}
+		root->visit_count += added;
+		total_visit_count += added;
+		exchanged_at = total_visit_count;
+		for (Node* child : root->children) {
+			if (child->visit_count) computeUCT(child, total_visit_count);
+			for (Node* grandchild : child->children)
+				if (grandchild->visit_count) computeUCT(grandchild, total_visit_count);
+		}
+	}
+
+	/**
+	 * leave only the own statistics in the root children after exchange, and add the results of the workers
+	 * if this is the coordinator, which stops the workers at once if the search is timed or interrupted
+	 */
+	void collect_cluster(Node* root, uint64_t job) {
+		std::vector<int> visits(board_type::size_n, 0), wins(board_type::size_n, 0);
+		if (cluster) cluster->gather(job, visits, wins, timeout > 0 || infinite || interrupted);
+		for (Node* child : root->children) {
+			auto it = exchanged.find(table_key(child));
+			if (it != exchanged.end()) child->visit_count -= it->second.second.visits, child->win_count -= it->second.second.wins;
+			int move = child->last_action.template position<board_type>().i;
+			child->visit_count += visits[move], child->win_count += wins[move];
+		}
+		exchanged.clear();
+	}
+
+	/* the key of a node in the table, which is the hash of the position and the player who moved into it */
+	static uint64_t table_key(Node* node) {
+		return node->state.hash() ^ (node->who == board::white ? 0x9e3779b97f4a7c15ull : 0);
+	}
+
+	/* the options of the workers of option cluster, which are the own ones except the identity and the cluster */
+	std::string cluster_config() {
+		static const std::set<std::string> excluded = { "name", "role", "seed", "deterministic", "cluster", "table", "grace" };
+		std::string config;
+		for (auto& option : meta)
+			if (excluded.count(option.first) == 0) config += (config.size() ? " " : "") + option.first + "=" + option.second.value;
+		return config;
+	}
+
+	/* prune the least-visited subtrees when the node budget is nearly exhausted, see option prune */
+	void maintain(Node* root) {
+		node_pool& pool = *pools[thread_pool::index()];
+		size_t low = board_type::size_n * batch_size;
+		if (prune == false || pool.available() >= low) return;
+		
+		/* collect the expanded nodes except the root, prune the cold and deep ones first */
+		std::vector<std::pair<Node*, int>> expanded;
+		std::vector<std::pair<Node*, int>> stack = { { root, 0 } };
+		while (stack.empty() == false) {
+			std::pair<Node*, int> top = stack.back();
+			stack.pop_back();
+			if (top.first != root) expanded.push_back(top);
+			for (Node* child : top.first->children)
+				if (child->children.empty() == false) stack.emplace_back(child, top.second + 1);
+		}
+		std::sort(expanded.begin(), expanded.end(), [](const std::pair<Node*, int>& a, const std::pair<Node*, int>& b) {
+			return a.first->visit_count != b.first->visit_count ? a.first->visit_count < b.first->visit_count : a.second > b.second;
+		});
+		
+		size_t target = std::max(low, node_budget / 4);
+		for (size_t i = 0; i < expanded.size() && pool.available() < target; ++i) {
+			delete_tree(expanded[i].first);
+			++prune_count;
+		}
+	}
+	
+	/* the node memory in megabytes, and the usage report for the budget */
+	static double node_megabytes(size_t nodes) { return nodes * (sizeof(Node) + sizeof(Node*)) / 1048576.0; }
+	std::string memory_report() const {
+		std::stringstream report;
+		report << std::fixed << std::setprecision(1);
+		report << "node memory: " << node_megabytes(node_created) << " MB resident, "
+		       << node_megabytes(node_peak) << " MB peak in use";
+		if (node_budget) report << " of " << node_megabytes(node_budget) << " MB budget ("
+		                        << (node_peak * 100.0 / node_budget) << "%)";
+		if (prune) report << ", " << prune_count << " subtrees pruned";
+		return report.str();
+	}
 	/******************* end of MCTS's tools **************************/
 
+	/******************* begin of proof tools *************************/
+	/**
+	 * the proof solver of the current tree (1 to thread_num in MCTS-parallel, or 0), pns for search=pns and df-pn otherwise
+	 * the solvers follow the trees rather than the workers, so that the kept tables do not depend on the scheduling
+	 */
+	static int& tree_index() {
+		static thread_local int k = 0;
+		return k;
+	}
+	proof_solver<board_type>& prover() {
+		std::unique_ptr<proof_solver<board_type>>& solver = solvers[tree_index()];
+		if (solver == nullptr)
+			solver.reset(new proof_solver<board_type>(action_mode == "pns" ? proof_solver<board_type>::pns : proof_solver<board_type>::dfpn));
+		return *solver;
+	}
+	
+	/* whether the state is small enough to be proven, i.e., at most 1/3 of the playable points are empty */
+	static bool endgame(const board_type& state) {
+		int empty_space = 0, playable = 0;
+		for (int i = 0; i < board_type::size_n; ++i) {
+			empty_space += (state(i) == board::empty);
+			playable += !board_type::is_hollow(i);
+		}
+		return empty_space * 3 <= playable;
+	}
+	
+	/* the time slice of the state in seconds from the time schedule */
+	double time_budget(const board_type& state) const {
+		int empty_space = 0, playable = 0;
+		for (int i = 0; i < board_type::size_n; ++i) {
+			if (state(i) == board::empty)
+				++empty_space;
+			if (!board_type::is_hollow(i))
+				++playable;
+		}
+		// the schedule is tuned for the 73 playable points of 9x9, scale it for other sizes
+		empty_space = std::max(0, std::min(35, 36 - empty_space * 73 / playable / 2));
+		return time_schedule[empty_space];
+	}
+	
+	/* try to prove a newly expanded node, a node without children is lost for the side to move */
+	void prove(Node* node) {
+		if (solve_budget == 0 || node->proven != board::empty) return;
+		board::piece_type tomove = (node->who == board::white ? board::black : board::white);
+		if (node->children.empty()) {
+			node->proven = node->who;
+			return;
+		}
+		if (!endgame(node->state)) return;
+		switch (attempt(node->state, tomove)) {
+		case proof_solver<board_type>::win:  node->proven = tomove; break;
+		case proof_solver<board_type>::loss: node->proven = node->who; break;
+		default: break;
+		}
+	}
+	
+	/**
+	 * prove the state for the side to move by the solver of the tree, where the proofs kept in its table are reused
+	 * at no cost, and the new searches share the nodes left for this move (option solve_move, 4 times solve by default)
+	 */
+	typename proof_solver<board_type>::result attempt(const board_type& state, board::piece_type tomove) {
+		typename proof_solver<board_type>::result known = prover().known(state, tomove);
+		if (known != proof_solver<board_type>::unknown) return known;
+		size_t budget = std::min(solve_budget, solve_left.load());
+		if (budget == 0) return proof_solver<board_type>::unknown;
+		typename proof_solver<board_type>::result result = prover().solve(state, tomove, budget, [this]() { return bool(interrupted); });
+		size_t used = prover().nodes(), left = solve_left;
+		while (!solve_left.compare_exchange_weak(left, left - std::min(left, used)));
+		return result;
+	}
+
+	/**
+	 * mark the node proven if a child wins for the side to move, or all children lose for it, where the moves filling
+	 * own eyes pruned by the expansion (option safe) are expanded first, since such a tempo move may be the only win
+	 */
+	void settle(Node* node) {
+		if (node->proven != board::empty || node->children.empty()) return;
+		bool lost = true;
+		for (Node* child : node->children) {
+			if (child->proven == child->who) {
+				node->proven = child->who;
+				return;
+			}
+			lost = lost && (child->proven == node->who);
+		}
+		if (lost && safe && regrow(node)) return;
+		if (lost) node->proven = node->who;
+	}
+
+	/* expand the pruned moves filling own eyes, and return false if there is none (or they are already expanded) */
+	bool regrow(Node* node) {
+		safe_points<board_type> safety(node->state);
+		board::piece_type tomove = (node->who == board::black ? board::white : board::black);
+		for (Node* child : node->children)
+			if (safety.wasted(child->last_action.template position<board_type>().i, tomove)) return false;
+		node_pool& pool = *pools[thread_pool::index()];
+		if (pool.reserve(board_type::size_n) == false) return true; // not proven until they can be expanded
+		size_t before = node->children.size();
+		grow(node, pool, safety, true);
+		return node->children.size() > before;
+	}
+	/******************* end of proof tools ***************************/
+
+	/******************* begin of tree persistence ********************/
+	/**
+	 * the file of a search tree: a header with the root state, followed by the nodes in preorder as fixed-size
+	 * records, so that the file can be mapped into memory and read in place; each node is followed by its children,
+	 * each with its whole subtree; this MCTS keeps no RAVE statistics, and the flags are reserved for them
+	 */
+	struct tree_header {
+		char magic[8];      /* "NOGOTREE" */
+		uint32_t version, flags;
+		uint16_t size_x, size_y;
+		uint32_t count;     /* the number of records */
+		uint8_t tomove;     /* the side to move at the root */
+		uint8_t cells[board_type::size_n];
+	};
+	struct tree_record {
+		int16_t move;       /* the point of the move into the node, -1 for the root */
+		uint8_t who, proven;
+		uint32_t children;
+		int32_t visits, wins;
+	};
+	static size_t tree_offset() { return (sizeof(tree_header) + 15) / 16 * 16; } /* of the first record */
+
+	/* the root of the state, which resumes the kept tree if it is of the same state, or starts a new tree */
+	Node* adopt(const board_type& state, bool resume = true) {
+		pools.resize(std::max<size_t>(pools.size(), 1));
+		if (pools[0] == nullptr) pools[0].reset(new node_pool(*this));
+		board::piece_type root_who = (who == board::white ? board::black : board::white);
+		typedef typename board_type::grid grid;
+		if (kept && resume && kept->who == root_who && (const grid&)kept->state == (const grid&)state) return kept;
+		discard();
+		kept = pools[0]->alloc();
+		kept->state = state;
+		kept->state.info({ who });
+		kept->who = root_who;
+		return kept;
+	}
+	void discard() {
+		if (kept == nullptr) return;
+		delete_tree(kept);
+		pools[thread_pool::index()]->release(kept);
+		kept = nullptr;
+	}
+
+	/* save the tree of the last search, which is kept by search=MCTS */
+	void save_tree(const std::string& path) const {
+		if (kept == nullptr) throw std::invalid_argument("no search tree to save");
+		std::vector<tree_record> records;
+		std::function<void(const Node*)> flatten = [&](const Node* node) {
+			int16_t move = (node == kept ? -1 : node->last_action.template position<board_type>().i);
+			records.push_back({ move, uint8_t(node->who), uint8_t(node->proven), uint32_t(node->children.size()),
+			                    node->visit_count, node->win_count });
+			for (const Node* child : node->children) flatten(child);
+		};
+		flatten(kept);
+		tree_header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "NOGOTREE", 8);
+		header.version = 1;
+		header.size_x = board_type::size_x, header.size_y = board_type::size_y;
+		header.count = records.size();
+		header.tomove = who;
+		for (int i = 0; i < board_type::size_n; ++i) header.cells[i] = kept->state(i);
+		std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) throw std::invalid_argument("cannot open tree file: " + path);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(std::string(tree_offset() - sizeof(header), '\0').data(), tree_offset() - sizeof(header));
+		out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(tree_record));
+		if (!out) throw std::invalid_argument("cannot write tree file: " + path);
+	}
+
+	/**
+	 * load a tree saved for the same side, so that the next search of its root state resumes from it;
+	 * with merge, the statistics are added to the kept tree of the same state, e.g., a tree of another run
+	 */
+	void load_tree(const std::string& path, bool merge = false) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) throw std::invalid_argument("cannot open tree file: " + path);
+		struct stat st;
+		size_t size = (fstat(fd, &st) == 0 ? st.st_size : 0);
+		void* data = (size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED);
+		close(fd);
+		if (data == MAP_FAILED) throw std::invalid_argument("cannot map tree file: " + path);
+		std::unique_ptr<void, std::function<void(void*)>> mapping(data, [size](void* p) { munmap(p, size); });
+
+		const tree_header& header = *static_cast<const tree_header*>(data);
+		const tree_record* records = reinterpret_cast<const tree_record*>(static_cast<const char*>(data) + tree_offset());
+		size_t count = (size >= tree_offset() ? header.count : 0);
+		if (size < tree_offset() || std::memcmp(header.magic, "NOGOTREE", 8) != 0 || header.version != 1 || header.flags != 0
+		    || header.size_x != board_type::size_x || header.size_y != board_type::size_y
+		    || count == 0 || size != tree_offset() + count * sizeof(tree_record))
+			throw std::invalid_argument("invalid tree file: " + path);
+		std::function<size_t(size_t)> skip = [&](size_t at) { /* the end of the subtree, or count + 1 if truncated */
+			uint32_t children = records[at++].children;
+			for (uint32_t c = 0; c < children && at < count; ++c) at = skip(at);
+			return at;
+		};
+		if (skip(0) != count) throw std::invalid_argument("invalid tree file: " + path);
+		if (header.tomove != who) throw std::invalid_argument("the tree is not for " + this->role());
+
+		board_type state;
+		for (int i = 0; i < board_type::size_n; ++i) state(i) = board::cell(header.cells[i]);
+		state.refresh();
+		state.info({ who });
+		Node* root = adopt(state, merge);
+		size_t at = 0;
+		try {
+			graft(root, records, at);
+		} catch (...) {
+			discard();
+			throw;
+		}
+		std::function<void(Node*)> evaluate = [&](Node* node) {
+			if (node->visit_count) computeUCT(node, root->visit_count);
+			for (Node* child : node->children) evaluate(child);
+		};
+		evaluate(root);
+	}
+
+	/* add the statistics of the record at (at) and its subtree to the node */
+	void graft(Node* node, const tree_record* records, size_t& at) {
+		const tree_record& record = records[at++];
+		node->visit_count += record.visits;
+		node->win_count += record.wins;
+		if (record.proven != board::empty) node->proven = board::piece_type(record.proven);
+		for (uint32_t c = 0; c < record.children; ++c) {
+			int move = records[at].move;
+			Node* child = nullptr;
+			for (Node* x : node->children)
+				if (x->last_action.template position<board_type>().i == move) child = x;
+			if (child == nullptr) {
+				board::piece_type child_who = (node->who == board::black ? board::white : board::black);
+				action::place child_move(move, child_who);
+				board_type after = node->state;
+				if (move < 0 || move >= board_type::size_n || child_move.apply(after) != board::legal)
+					throw std::invalid_argument("invalid move in tree file");
+				child = pools[0]->alloc();
+				child->state = after;
+				child->parent = node;
+				child->last_action = child_move;
+				child->who = child_who;
+				node->children.push_back(child);
+			}
+			graft(child, records, at);
+		}
+	}
+	/******************* end of tree persistence **********************/
+
+	/******************* begin of search control **********************/
+	/* whether the search should go on, at least one simulation is required before being interrupted */
+	bool searching(bool budget_left, int total_visit_count) const {
+		return (budget_left || infinite) && !(stopping() && total_visit_count > 0);
+	}
+
+	/* whether the search is interrupted, or its analysis round is over, see analyze */
+	bool stopping() const {
+		return interrupted || (round_end != std::chrono::steady_clock::time_point() && std::chrono::steady_clock::now() >= round_end);
+	}
+	
+	/**
+	 * the dynamic time policy of MCTS (option dynamic), which is checked after each simulation with the visits left
+	 * (estimated by the speed so far if timed): the search stops as soon as the leading move cannot be overtaken,
+	 * while the time limit is extended by the time saved earlier in the game (up to twice the slice) when the leading
+	 * move changed late or the top two moves are close, so the game never takes more than the schedule in total
+	 */
+	struct time_control {
+		double slice, limit;      /* the time slice of the schedule, and the limit which may be extended */
+		Node* leader = nullptr;   /* the leading child at the last check */
+		double changed = 0;       /* the time when the leading child changed last */
+		time_control(double slice = 0) : slice(slice), limit(slice) {}
+	};
+	bool steady(Node* root, time_control& control, double elapsed, double left) {
+		Node* leader = nullptr;
+		int first = 0, second = 0;
+		for (Node* child : root->children) {
+			if (child->proven != board::empty) continue;
+			if (child->visit_count > first) second = first, first = child->visit_count, leader = child;
+			else if (child->visit_count > second) second = child->visit_count;
+		}
+		if (leader != control.leader) control.leader = leader, control.changed = elapsed;
+		if (first - second > left) return false; // the leader cannot be overtaken
+		if (control.slice > 0 && elapsed >= control.limit && control.limit < 2 * control.slice) {
+			bool unstable = control.changed >= 0.5 * control.limit || second * 10 >= first * 9;
+			double extra = std::min(time_bank, control.slice / 2);
+			if (unstable && extra > 0) control.limit += extra, time_bank -= extra;
+		}
+		return true;
+	}
+
+	/* one simulation through the node, which is the root or below the root, by the tree search below it */
+	void descend(Node* root, Node* from, int& total_visit_count) {
+		maintain(root);
+		Node* leaf = selection(from);
+		if (expension(leaf))
+			prove(leaf);
+		board::piece_type winner = simulation(leaf, engine);
+		backpropagation(root, leaf, winner, ++total_visit_count);
+	}
+
+	/**
+	 * the root search by sequential halving with the Gumbel-top-k sampling (Danihelka et al. 2022), see option gumbel:
+	 * k moves are sampled without replacement by the largest Gumbel noises g (a uniform sample, since there is no prior),
+	 * then the budget is split into log2(k) rounds, where each round spreads its simulations evenly over the remaining
+	 * candidates and keeps the better half by g + sigma(q), sigma(q) = (50 + the most visits) * q;
+	 * the budget is in simulations, or in seconds if timed; return the chosen child, or nullptr if all moves lose
+	 */
+	Node* halving(Node* root, int& total_visit_count, double budget, bool timed) {
+		std::vector<std::pair<double, Node*>> candidates;
+		for (Node* child : root->children) {
+			if (child->proven == child->who) return child;
+			if (child->proven != board::empty) continue;
+			double u = ((engine() >> 11) + 0.5) / 9007199254740992.0; // in (0, 1)
+			candidates.emplace_back(-std::log(-std::log(u)), child);
+		}
+		if (candidates.empty()) return nullptr;
+		std::sort(candidates.begin(), candidates.end(), std::greater<std::pair<double, Node*>>());
+		candidates.resize(std::min<size_t>(candidates.size(), std::max(gumbel, 1)));
+
+		int rounds = 1;
+		while ((size_t(1) << rounds) < candidates.size()) ++rounds;
+		auto start = std::chrono::steady_clock::now();
+		auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+		auto score = [&](int most, Node* child) {
+			if (child->proven != board::empty) return child->proven == child->who ? 1e9 : -1e9;
+			double q = child->visit_count ? double(child->win_count) / child->visit_count : 0.5;
+			return (50 + most) * q;
+		};
+		for (int r = 0; r < rounds && candidates.size() > 1 && !interrupted; ++r) {
+			if (timed) {
+				double deadline = budget * (r + 1) / rounds;
+				for (size_t k = 0; searching(elapsed() < deadline, total_visit_count); k = (k + 1) % candidates.size())
+					descend(root, candidates[k].second, total_visit_count);
+			} else {
+				int n = std::max<int>(1, budget / (rounds * candidates.size()));
+				for (auto& candidate : candidates)
+					for (int j = 0; j < n && searching(true, total_visit_count); ++j)
+						descend(root, candidate.second, total_visit_count);
+			}
+			int most = 0;
+			for (auto& candidate : candidates) most = std::max(most, candidate.second->visit_count);
+			std::stable_sort(candidates.begin(), candidates.end(), [&](const std::pair<double, Node*>& a, const std::pair<double, Node*>& b) {
+				return a.first + score(most, a.second) > b.first + score(most, b.second);
+			});
+			candidates.resize((candidates.size() + 1) / 2);
+		}
+		return candidates[0].second;
+	}
+
+	/* stop the ongoing search as soon as possible, which is safe to be called from other threads */
+	void interrupt(bool stop = true) { interrupted = stop; }
+	bool is_interrupted() const { return interrupted; }
+	
+	/**
+	 * search the state without any budget until being interrupted, and report the progress
+	 * or only for a round of the given seconds, after which the search of the same state is resumed by the next round
+	 */
+	virtual action analyze(const board_type& state, std::function<void(const std::string&)> hook, double interval = 1.0, double round = 0) {
+		infinite = true;
+		reporter = hook;
+		report_interval = interval;
+		last_report = std::chrono::steady_clock::now();
+		if (round > 0) round_end = last_report + std::chrono::microseconds(int64_t(round * 1e6));
+		action best_action = player::take_action(state);
+		round_end = std::chrono::steady_clock::time_point();
+		reporter = nullptr;
+		infinite = false;
+		return best_action;
+	}
+
+	/* the threads used by a search, including the worker processes of option cluster */
+	int concurrency() const {
+		bool pooled = (action_mode == "MCTS-parallel" || (action_mode == "alpha-beta" && !deterministic));
+		return (pooled ? std::max(thread_num, 1) : 1) + (cluster ? int(cluster->workers()) : 0);
+	}
+	
+	/* share the table of a cluster, which is attached by the workers, see cluster_worker */
+	void join(transposition_table* shared) { table = shared; }
+
+	/* the best move of the last finished search */
+	action best_move() const { return best_so_far; }
+
+	/* the visits and wins of the root children by the moves in the last search, all zero if not searched by MCTS */
+	const std::vector<int>& root_visits() const { return last_visits; }
+	const std::vector<int>& root_wins() const { return last_wins; }
+	void tally(Node* root) {
+		for (Node* child : root->children) {
+			last_visits[child->last_action.template position<board_type>().i] = child->visit_count;
+			last_wins[child->last_action.template position<board_type>().i] = child->win_count;
+		}
+	}
+
+	/* the parameters tuned by the tuner, see tune.h */
+	double exploration() const { return explore; }
+	std::vector<double> schedule() const { return std::vector<double>(time_schedule, time_schedule + 36); }
+	
+	/* report the root children sorted by visits, e.g., "info move E5 visits 120 winrate 0.5417 ..." */
+	void report(Node* root, int total_visit_count) {
+		if (!reporter) return;
+		auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(now - last_report).count() < report_interval) return;
+		last_report = now;
+		std::vector<Node*> children(root->children);
+		std::sort(children.begin(), children.end(), [](Node* a, Node* b) { return a->visit_count > b->visit_count; });
+		std::stringstream info;
+		info << std::fixed << std::setprecision(4);
+		for (Node* child : children) {
+			if (child->visit_count == 0) break;
+			info << (info.tellp() ? " " : "") << "info move " << child->last_action.template position<board_type>()
+			     << " visits " << child->visit_count << " winrate " << (double)child->win_count / child->visit_count;
+		}
+		reporter(info.str());
+	}
+	/******************* end of search control ************************/
+
 	void printNode(Node* node) {
 		std::cout << "##########################\n"
 		       	  << "win_count : " << node->win_count << std::endl
@@ -291,6 +1097,16 @@ public:
 			  << "##########################\n";
 	}
 
+	virtual ~player() { discard(); }
+
+	virtual void open_episode(const std::string& flag = "") {
+		time_bank = 0;
+	}
+
+	virtual void close_episode(const std::string& flag = "") {
+		if (node_budget) std::cerr << this->name() << " " << memory_report() << std::endl;
+	}
+
 	//virtual void open_episode(const std::string& tag) {
 	//	start_time = clock();
 	//}
@@ -299,17 +1115,43 @@ public:
 	//	std::cout << who << " use time = " << (double)(end_time - start_time)/CLOCKS_PER_SEC << "second \n";
 	//}
 
-	virtual action take_action(const board& state) {
+	virtual action take_action(const board_type& state) {
+		last_visits.assign(board_type::size_n, 0);
+		last_wins.assign(board_type::size_n, 0);
+
+		// play the proven move if the regions decide the win
+		if (use_region) {
+			regions.refill();
+			int move = regions.winning_move(state, who);
+			if (move != -1) {
+				best_so_far = action::place(move, who);
+				return best_so_far;
+			}
+		}
+
+		// play the proven move instantly if the endgame is solved
+		solve_left = solve_move;
+		if (solve_budget && (action_mode == "MCTS" || action_mode == "MCTS-parallel") && endgame(state)) {
+			if (attempt(state, who) == proof_solver<board_type>::win) {
+				best_so_far = action::place(prover().best_move(), who);
+				return best_so_far;
+			}
+		}
 
 		// default action : random
 		if (action_mode == "random" or action_mode.empty()){
-			std::shuffle(space.begin(), space.end(), engine);
-			for (const action::place& move : space) {
-				board after = state;
+			std::vector<action::place> moves(space);
+			while (moves.empty() == false) { /* draw the moves one by one until a legal one */
+				size_t k = engine.bounded(moves.size());
+				action::place move = moves[k];
+				board_type after = state;
 				if (move.apply(after) == board::legal) {
 					//std::cout << move << "\n";
+					best_so_far = move;
 					return move;
 				}
+				moves[k] = moves.back();
+				moves.pop_back();
 			}
 			//std::cout << state << "\n";
 			return action();
@@ -317,135 +1159,238 @@ public:
 		
 
 		else if (action_mode == "MCTS"){
-			clock_t start_time, end_time, total_time = 0;
-			start_time = clock();
+			// the time is measured by the wall clock, since clock() sums up the CPU time of all threads,
+			// e.g., of the games played in parallel by the tuner
+			auto start_time = std::chrono::steady_clock::now();
+			double total_time = 0;
 			
-			Node* root = new Node;
+			// resume the kept tree if it is of the same state, e.g., a loaded tree, but not with the table of a cluster,
+			// since the kept visits would be published again as the own ones
+			Node* root = adopt(state, table == nullptr);
 			board::piece_type winner;
-			int total_visit_count = 0;
+			int total_visit_count = root->visit_count;
+			uint64_t job = (cluster ? cluster->post(state, who, timeout > 0 || infinite) : 0);
+			exchanged_at = total_visit_count;
 			
-			root->state = state;
 			//std::cout << root->state << "\n";
-			root->who = (who == board::white ? board::black : board::white);
-			expension(root);
+			if (root->children.empty())
+				expension(root, true);
+			if (net.empty() == false)
+				evaluate(root);
 			
+			if (gumbel && !infinite && root->proven == board::empty) { // the root search by sequential halving
+				bool timed = timeout > 0;
+				Node* chosen = halving(root, total_visit_count, timed ? 0.95 * time_budget(state) : simulation_count, timed);
+				if (chosen) {
+					if (table) collect_cluster(root, job);
+					tally(root);
+					best_so_far = chosen->last_action;
+					return best_so_far;
+				}
+			}
 			
 			// default time limit = 1s //
 			if (timeout > 0) {
-				int empty_space = 0;
-				for (int i = 0; i < 9; ++i) {
-					for (int j = 0; j < 9; ++j) {
-						if (state[i][j] == board::empty)
-							++empty_space;
+				double time_limit = time_budget(state);
+				time_control control(0.95 * time_limit);
+				int visited = total_visit_count;
+				while(searching(total_time < control.limit, total_visit_count) && root->proven == board::empty) {
+					report(root, total_visit_count);
+					if (table) exchange(root, total_visit_count);
+					if (batch_size > 1) {
+						batch_search(root, total_visit_count, engine);
+					}
+					else {
+						maintain(root);
+						Node* best_node = selection(root);
+						if (expension(best_node))
+							prove(best_node);
+						winner = simulation(best_node, engine);
+					
+						++total_visit_count;
+						backpropagation(root, best_node, winner, total_visit_count);
+					}
+					total_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+					if (dynamic && !infinite) {
+						double speed = (total_visit_count - visited) / std::max(total_time, 1e-6);
+						if (!steady(root, control, total_time, speed * (control.limit - total_time))) break;
 					}
 				}
-				empty_space = 36 - empty_space / 2;	
-				while(total_time < 0.95 * time_schedule[empty_space]) {
-									
-					Node* best_node = selection(root);
-					expension(best_node);
-					winner = simulation(best_node);
-				
-					++total_visit_count;
-					backpropagation(root, best_node, winner, total_visit_count);
-					end_time = clock();
-
-					total_time = (double)(end_time-start_time)/CLOCKS_PER_SEC;
-				}	
+				if (dynamic) time_bank += std::max(0.0, control.slice - total_time);
 			}
 			else {
 				int cnt = 0;
+				time_control control;
 				
-				while (cnt < simulation_count) {
+				while (searching(cnt < simulation_count, total_visit_count) && root->proven == board::empty) {
+					report(root, total_visit_count);
+					if (table) exchange(root, total_visit_count);
+					if (batch_size > 1) {
+						batch_search(root, total_visit_count, engine);
+						cnt += batch_size;
+						continue;
+					}
 					
-					 Node* best_node = selection(root);
+					maintain(root);
+					Node* best_node = selection(root);
 
-					expension(best_node);
-					winner = simulation(best_node);
+					if (expension(best_node))
+						prove(best_node);
+					winner = simulation(best_node, engine);
 
 					++total_visit_count;
 					backpropagation(root, best_node, winner, total_visit_count);
 					
 					++cnt;
+					if (dynamic && !infinite && !steady(root, control, 0, simulation_count - cnt)) break;
 				}
 				
 			}
 			action best_action;
+			if (table) collect_cluster(root, job);
+			tally(root);
 			best_action = bestAction(root);
+			best_so_far = best_action;
 			//action best_action = bestAction(root);
 			//std::cout << "take action : " << best_action << std::endl;
-			delete_tree(root);
-			free(root);
+			// the tree is kept until the next search of another state, see save_tree
 			return best_action;
 		}
 		else if (action_mode == "MCTS-parallel") {
-			omp_set_num_threads(thread_num);
+			workers->wait(); // the teardown of the last trees
+			pools.resize(std::max<size_t>(pools.size(), thread_num + 1));
+			for (auto& pool : pools)
+				if (pool == nullptr) pool.reset(new node_pool(*this));
 			//std::cout << state << std::endl;
 			std::vector<Node*> roots(thread_num);
+			std::vector<int> visits(thread_num, 0);
+			std::vector<xoshiro256> engines;
+			uint64_t seed = engine(); /* the trees draw from the streams of a seed from the agent */
+			for(int i = 0; i < thread_num; ++i) {
+				roots[i] = pools[thread_pool::index()]->alloc();
+				roots[i]->state = state;
+				roots[i]->who = (who == board::white ? board::black : board::white);
+				expension(roots[i], true);
+				if (net.empty() == false)
+					evaluate(roots[i]);
+				engines.emplace_back(seed, i);
+			}
 			
 
 
-			if (timeout > 0) {
-				
-			}
-			if (simulation_count > 0) {
-				//clock_t start_time = clock(), end_time;
-				#pragma omp parallel for
-				for(int i = 0; i < thread_num; ++i) {
-					int total_visit_count = 0;
-					board::piece_type winner;
-
-					roots[i] = new Node;
-					roots[i]->state = state;
-					roots[i]->who = (who == board::white ? board::black : board::white);
-					
-					expension(roots[i]);
-					
-					while (total_visit_count < simulation_count) {
+			shared_stats shared(thread_num);
+			std::vector<int> synced(thread_num, 0);
+			auto start_time = std::chrono::steady_clock::now();
+			double time_limit = (timeout > 0 ? 0.95 * time_budget(state) : 0);
+			if (timeout > 0 || simulation_count > 0) {
+				/* each tree grows by a few simulations per task, and then submits the rest as a new task,
+				// so that the idle workers can take over the trees waiting in the queues */
+				std::function<void(int)> grow = [&](int i) {
+					tree_index() = i + 1;
+					auto growing = [&]() {
+						bool budget_left = (timeout > 0)
+							? std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() < time_limit
+							: visits[i] < simulation_count;
+						return searching(budget_left, visits[i]) && roots[i]->proven == board::empty;
+					};
+					for (int n = 0; n < 64 && growing(); ++n) {
+						int total = visits[i] + shared.extra[i]; // including the visits shared by the other trees
+						if (i == 0) report(roots[i], total);
+						if (batch_size > 1) {
+							batch_search(roots[i], total, engines[i]);
+							visits[i] = total - shared.extra[i];
+							continue;
+						}
+						maintain(roots[i]);
 						Node* best_node = selection(roots[i]);
 						
-						expension(best_node);
+						if (expension(best_node))
+							prove(best_node);
 						
-						winner = simulation(best_node, true);
+						board::piece_type winner = simulation(best_node, engines[i]);
 						
-						++total_visit_count;
-						
-						backpropagation(roots[i], best_node, winner, total_visit_count);
+						++visits[i];
 						
+						backpropagation(roots[i], best_node, winner, visits[i] + shared.extra[i]);
 					}
-					
-				}
-				//end_time = clock();
-				//std::cout << "total cost time at simulation: " << simulation_count << " is :" << (double)(end_time - start_time)/CLOCKS_PER_SEC << " seconds\n";
+					if (share_interval && visits[i] - synced[i] >= share_interval) {
+						share(roots[i], i, visits[i], shared);
+						synced[i] = visits[i];
+					}
+					if (growing())
+						workers->submit(std::bind(grow, i));
+				};
+				for(int i = 0; i < thread_num; ++i)
+					workers->submit(std::bind(grow, i));
+				workers->wait();
 			}
 
-			int bound = roots[0]->children.size();
-
-			// aggregate count result
-			for (int thread_idx = 1; thread_idx < thread_num; ++thread_idx) {
-
-				if (roots[thread_idx]->children.size() != bound) throw std::invalid_argument("children size error");
-				for(int i = 0; i < bound ;++i) {
-					roots[0]->children[i]->visit_count += roots[thread_idx]->children[i]->visit_count;
+			// aggregate the own visits and wins of each tree by the moves, into the children of the first tree
+			std::vector<typename shared_stats::record> merged(board_type::size_n);
+			std::vector<board::piece_type> proven(board_type::size_n, board::empty);
+			for (int i = 0; i < thread_num; ++i) {
+				for (Node* child : roots[i]->children) {
+					int move = child->last_action.template position<board_type>().i;
+					const typename shared_stats::record& in = shared.imported[i][shared_stats::key(move)];
+					merged[move].visits += child->visit_count - in.visits;
+					merged[move].wins += child->win_count - in.wins;
+					if (child->proven != board::empty) proven[move] = child->proven;
 				}
 			}
-			
-
+			for (Node* child : roots[0]->children) {
+				int move = child->last_action.template position<board_type>().i;
+				child->visit_count = merged[move].visits;
+				child->win_count = merged[move].wins;
+				child->proven = proven[move];
+			}
 			
 			action best_action;
+			tally(roots[0]);
 			best_action = bestAction(roots[0]);
+			best_so_far = best_action;
 			//std::cout << "best action : " << best_action << "\n";
 			//sleep(1);
-			#pragma omp parallel for
-			for(int i = 0; i < thread_num; ++i) {
-				delete_tree(roots[i]);
-				free(roots[i]);
+			/* tear down the trees in the background, which is waited for by the next search */
+			for(Node* root : roots) {
+				workers->submit([this, root]() {
+					delete_tree(root);
+					pools[thread_pool::index()]->release(root);
+				});
 			}
 			return best_action;
 
 		}
+		else if (action_mode == "pns" || action_mode == "df-pn") {
+			// prove or disprove the win within the node budget and the time schedule, then play the proven
+			// move, or the most promising one if unproven
+			auto start_time = std::chrono::steady_clock::now();
+			double time_limit = (timeout > 0 ? 0.95 * time_budget(state) : 0);
+			auto stop = [&]() {
+				return stopping() || (time_limit > 0 && !infinite
+				       && std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() >= time_limit);
+			};
+			prover().solve(state, who, infinite ? size_t(-1) : proof_budget, stop);
+			int move = prover().best_move();
+			best_so_far = (move != -1 ? action(action::place(move, who)) : action());
+			return best_so_far;
+		}
 		else if (action_mode == "alpha-beta") {
-			throw std::invalid_argument("not be implemented");
+			// deepen up to the depth, or until the time schedule runs out if timeout is given without depth
+			// Lazy SMP is not reproducible, hence only one thread searches with deterministic=1
+			if (alphabeta == nullptr) alphabeta.reset(new alphabeta_search<board_type>());
+			double time_limit = (timeout > 0 && !infinite ? 0.95 * time_budget(state) : 0);
+			bool unbounded = infinite || (timeout > 0 && meta.find("depth") == meta.end());
+			alphabeta->progress = [this](int depth, int score, int move) {
+				if (!reporter || move == -1) return;
+				std::stringstream info;
+				info << "info depth " << depth << " score " << score
+				     << " move " << action::place(move, who).template position<board_type>();
+				reporter(info.str());
+			};
+			int move = alphabeta->search(state, who, unbounded ? board_type::size_n : search_depth, time_limit,
+			                             deterministic ? nullptr : workers.get(), [this]() { return stopping(); });
+			best_so_far = (move != -1 ? action(action::place(move, who)) : action());
+			return best_so_far;
 		}
 		else {
 			throw std::invalid_argument("illegal action mode");
@@ -454,16 +1399,61 @@ public:
 	}
 
 private:
+	using random_agent<board_type>::meta;
+	using random_agent<board_type>::engine;
+	using random_agent<board_type>::deterministic;
 	std::vector<action::place> space, white_space, black_space;
 	board::piece_type who;
 	std::string action_mode;
 	int simulation_count = 0;
 	clock_t timeout = 0, start_time, end_time;
 	int thread_num = 4;   /* default thread number = 4  */
+	int batch_size = 1;   /* leaves evaluated together by batched playouts, 1 for the scalar playout */
+	batch_playout<board_type> playout;
+	std::string rollout = "random"; /* the policy of the scalar playouts, random or pattern */
+	pattern_table patterns;
+	pattern_playout<board_type> pattern_rollout{patterns};
+	int safe = 0;             /* the safe-point analysis, 1 for the expansion, 2 for also the playouts */
+	bool use_region = false;  /* decide the endgames by the regions, see option region for the size limit */
+	region_solver<board_type> regions;
+	size_t solve_budget = 0;       /* the df-pn nodes for proving each new endgame leaf in MCTS, 0 for disabled */
+	size_t solve_move = 0;         /* the df-pn nodes of all proofs of a move, see attempt */
+	std::atomic<size_t> solve_left{0};
+	size_t proof_budget = 100000;  /* the nodes of search=pns or search=df-pn */
+	std::vector<std::unique_ptr<proof_solver<board_type>>> solvers; /* one solver per search thread, as the pools */
+	int search_depth = 3;          /* the depth of search=alpha-beta */
+	std::unique_ptr<alphabeta_search<board_type>> alphabeta;
+	Node* kept = nullptr;          /* the tree of the last search of search=MCTS */
+	size_t node_budget = 0;   /* the maximum number of nodes from option memory (in MB), 0 for unlimited */
+	bool prune = false;       /* prune the cold subtrees instead of stopping expansion when over budget */
+	std::atomic<size_t> node_created{0}, node_live{0}, node_peak{0};
+	std::atomic<size_t> prune_count{0};
+	std::vector<std::unique_ptr<node_pool>> pools; /* one pool per search thread, indexed by thread_pool::index() */
+	std::atomic<bool> interrupted{false};
+	bool infinite = false;    /* search until being interrupted, see analyze */
+	std::chrono::steady_clock::time_point round_end; /* the end of the analysis round, or zero for none */
+	std::function<void(const std::string&)> reporter;
+	double report_interval = 1.0;
+	std::chrono::steady_clock::time_point last_report;
+	action best_so_far;
+	std::vector<int> last_visits, last_wins; /* see root_visits and root_wins */
 	double time_schedule[36] = {0.1, 0.1, 0.1, 0.2, 0.2, 0.2, 0.7, 0.7,
 	       			    0.7, 1.4, 1.4, 1.4, 1.5, 1.5, 1.5, 2.0,
 				    2.0, 2.0, 1.5, 1.5, 1.5, 1.5, 1.5, 1.5, 1.0,
 				    1.0, 1.0, 0.5, 0.5, 0.5, 0.4, 0.4, 0.4, 0.2,
 				    0.2, 0.2
 				    };
+	double explore = 0.5;     /* the exploration constant of UCT */
+	bool dynamic = false;     /* the dynamic time policy of MCTS, see steady */
+	int share_interval = 0;   /* the simulations of each tree between the exchanges of MCTS-parallel, 0 for none */
+	int gumbel = 0;           /* the moves sampled for the sequential halving at the root of MCTS, 0 for UCT */
+	double time_bank = 0;     /* the time saved by the dynamic time policy in this game */
+	policy_value_net<board_type> net; /* the network of the priors and the values, see option net */
+	double mix = 1;           /* the probability of using the value of the network instead of a playout */
+	bool pin = false;         /* pin the workers to the CPUs */
+	std::unique_ptr<search_cluster<board_type>> cluster; /* the worker processes of option cluster */
+	transposition_table* table = nullptr; /* the table of the cluster, of the coordinator or of a worker */
+	std::map<uint64_t, std::pair<typename shared_stats::record, typename shared_stats::record>> exchanged; /* published, imported */
+	int exchanged_at = 0;     /* the total visits at the last exchange */
+	std::unique_ptr<thread_pool> workers; /* for MCTS-parallel and alpha-beta, destroyed first as its tasks use the others */
 };
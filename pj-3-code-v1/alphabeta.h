@@ -0,0 +1,236 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * alphabeta.h: Iterative-deepening alpha-beta search with Lazy SMP over a shared transposition table
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+#include "board.h"
+#include "safety.h"
+#include "threads.h"
+
+/**
+ * the transposition table shared by the search threads without locks
+ * each slot keeps the data and the key xor the data (Hyatt and Mann 2002), so that a slot torn by
+ * concurrent writes fails the key check and is simply ignored
+ */
+class shared_table {
+public:
+	enum bound { exact = 0, lower = 1, upper = 2 };
+	struct entry {
+		int move, score, depth;
+		bound type;
+	};
+
+	shared_table(size_t bits = 20) : slots(size_t(1) << bits) {}
+
+	bool probe(uint64_t key, entry& e) const {
+		const slot& s = slots[key & (slots.size() - 1)];
+		uint64_t data = s.data.load(std::memory_order_relaxed);
+		if ((s.check.load(std::memory_order_relaxed) ^ data) != key) return false;
+		e.move = int(data & 0xffff) - 1;
+		e.score = int16_t(data >> 16);
+		e.depth = int(data >> 32 & 0xff);
+		e.type = bound(data >> 40 & 3);
+		return true;
+	}
+	void store(uint64_t key, const entry& e) {
+		slot& s = slots[key & (slots.size() - 1)];
+		uint64_t old = s.data.load(std::memory_order_relaxed);
+		bool same = (s.check.load(std::memory_order_relaxed) ^ old) == key;
+		if (same && int(old >> 32 & 0xff) > e.depth && e.type != exact) return; // keep the deeper result
+		uint64_t data = uint64_t(uint16_t(e.move + 1)) | uint64_t(uint16_t(int16_t(e.score))) << 16
+		              | uint64_t(std::min(e.depth, 255)) << 32 | uint64_t(e.type) << 40;
+		s.check.store(key ^ data, std::memory_order_relaxed);
+		s.data.store(data, std::memory_order_relaxed);
+	}
+
+private:
+	struct slot {
+		std::atomic<uint64_t> check{0}, data{0};
+	};
+	std::vector<slot> slots;
+};
+
+/**
+ * the alpha-beta search of NoGo in the negamax form
+ *
+ * the static evaluation is the difference of the legal moves of both sides by the safe-point analysis,
+ * where the exclusive points (which the opponent can never take away) count double; the positions decided
+ * by the bounds of the remaining moves are scored as wins or losses directly
+ *
+ * the search deepens iteratively with aspiration windows around the last score until the depth or
+ * the time limit; with a thread pool, all workers search the same root (Lazy SMP) and share the results only by
+ * the transposition table, where the helpers start one ply deeper in turn and vary the move order
+ */
+template<class board_type>
+class alphabeta_search {
+public:
+	static constexpr int infinity = 30000, win = 20000;
+
+	alphabeta_search(size_t table_bits = 20) : table(table_bits) {}
+
+	/**
+	 * search the state for the side to move (who) up to the depth and within the time limit (in seconds, 0 for none),
+	 * by all workers of the pool, or only by the calling thread without a pool;
+	 * stop is polled every few thousand nodes, e.g., for being interrupted
+	 * return the best move, or -1 if there is no legal move
+	 */
+	int search(const board_type& state, unsigned who, int max_depth, double seconds, thread_pool* workers = nullptr,
+	           std::function<bool()> stop = nullptr) {
+		board_type root = state;
+		root.info({ board::piece_type(who) });
+		start = std::chrono::steady_clock::now();
+		limit = seconds;
+		halt = stop;
+		aborted = false;
+		node_count = 0;
+		best = -1, value = 0, reached = 0;
+
+		auto task = [&](int id) {
+			worker self(id);
+			deepen(root, max_depth, self);
+			if (self.id == 0) aborted = true; // the helpers stop once the main thread is finished
+			node_count += self.nodes;
+		};
+		if (workers) workers->run(workers->size(), task);
+		else task(0);
+		return best;
+	}
+
+	int score() const { return value; }
+	int depth() const { return reached; }
+	size_t nodes() const { return node_count; }
+
+	/* called after each finished iteration of the main thread with the depth, the score, and the best move */
+	std::function<void(int, int, int)> progress;
+
+protected:
+	struct worker {
+		int id;
+		size_t nodes = 0;
+		int root_move = -1;
+		int history[2][board_type::size_n] = {};
+		worker(int id) : id(id) {}
+	};
+
+	void deepen(const board_type& root, int max_depth, worker& self) {
+		int last = 0;
+		for (int depth = 1 + (self.id & 1); depth <= max_depth && !aborted; depth++) {
+			int score, delta = 8;
+			int alpha = (depth > 1 ? last - delta : -infinity), beta = (depth > 1 ? last + delta : infinity);
+			for (;;) { // the aspiration window is widened on each failure
+				score = negamax(root, depth, alpha, beta, 0, self);
+				if (aborted) break;
+				if (score <= alpha) alpha = std::max(alpha - delta, -infinity);
+				else if (score >= beta) beta = std::min(beta + delta, infinity);
+				else break;
+				delta *= 4;
+			}
+			if (aborted && !(self.id == 0 && depth == 1)) break; // the first iteration always gives a move
+			last = score;
+			if (self.id == 0) {
+				best = self.root_move, value = score, reached = depth;
+				if (progress) progress(depth, score, best);
+				if (std::abs(score) >= win - 256) break; // the game is decided
+			}
+		}
+	}
+
+	int negamax(const board_type& b, int depth, int alpha, int beta, int ply, worker& self) {
+		if ((++self.nodes & 4095) == 0 && timeout()) aborted = true;
+		if (aborted) return 0;
+		unsigned who = b.info().who_take_turns;
+		uint64_t key = b.hash() ^ (who == board::white ? ~0ull : 0ull);
+
+		shared_table::entry e;
+		int hint = -1;
+		if (table.probe(key, e)) {
+			hint = e.move;
+			int s = from_table(e.score, ply);
+			if (ply > 0 && e.depth >= depth) {
+				if (e.type == shared_table::exact) return s;
+				if (e.type == shared_table::lower && s >= beta) return s;
+				if (e.type == shared_table::upper && s <= alpha) return s;
+			}
+		}
+
+		safe_points<board_type> safety(b);
+		board::piece_type decided = safety.decided(who);
+		if (decided != board::empty && ply > 0) return decided == who ? win - ply : ply - win; // the root needs a move
+		if (depth <= 0) return evaluate(safety, who);
+
+		// the hinted move first, then by the history, and the moves filling own eyes last
+		// (they are not pruned, since such a tempo move may be the only win)
+		std::vector<int> moves;
+		const typename safe_points<board_type>::points& legal = safety.legal_points(who);
+		for (int i = legal._Find_first(); i < board_type::size_n; i = legal._Find_next(i))
+			moves.push_back(i);
+		if (moves.empty()) return ply - win; // no legal move, the side to move loses
+		if (self.id) std::rotate(moves.begin(), moves.begin() + (self.id * 7 + ply) % moves.size(), moves.end());
+		const int* history = self.history[who - 1];
+		std::stable_sort(moves.begin(), moves.end(), [&](int x, int y) {
+			if ((x == hint) != (y == hint)) return x == hint;
+			if (safety.wasted(x, who) != safety.wasted(y, who)) return safety.wasted(y, who);
+			return history[x] > history[y];
+		});
+
+		int alpha0 = alpha, best_score = -infinity, best_move = moves[0];
+		for (int i : moves) {
+			board_type after = b;
+			after.place(typename board_type::point(i));
+			int s = -negamax(after, depth - 1, -beta, -alpha, ply + 1, self);
+			if (aborted) return 0;
+			if (s > best_score) {
+				best_score = s, best_move = i;
+				if (ply == 0) self.root_move = i;
+			}
+			alpha = std::max(alpha, s);
+			if (alpha >= beta) {
+				self.history[who - 1][i] += depth * depth;
+				break;
+			}
+		}
+		shared_table::bound type = best_score <= alpha0 ? shared_table::upper : best_score >= beta ? shared_table::lower : shared_table::exact;
+		table.store(key, { best_move, to_table(best_score, ply), depth, type });
+		return best_score;
+	}
+
+	/* the evaluation for the side to move (who) */
+	static int evaluate(const safe_points<board_type>& safety, unsigned who) {
+		const typename safe_points<board_type>::points& mine = safety.legal_points(who), &theirs = safety.legal_points(3u - who);
+		int legal = int(mine.count()) - int(theirs.count());
+		int exclusive = int((mine & ~theirs).count()) - int((theirs & ~mine).count());
+		return legal + exclusive;
+	}
+
+	/* the win scores are kept relative to the node in the table */
+	static int to_table(int s, int ply) { return s >= win - 256 ? s + ply : s <= 256 - win ? s - ply : s; }
+	static int from_table(int s, int ply) { return s >= win - 256 ? s - ply : s <= 256 - win ? s + ply : s; }
+
+	bool timeout() const {
+		if (halt && halt()) return true;
+		return limit > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= limit;
+	}
+
+private:
+	shared_table table;
+	std::chrono::steady_clock::time_point start;
+	double limit = 0;
+	std::function<bool()> halt;
+	std::atomic<bool> aborted{false};
+	std::atomic<size_t> node_count{0};
+	int best = -1, value = 0, reached = 0;
+};
+
+template<class board_type> constexpr int alphabeta_search<board_type>::infinity;
+template<class board_type> constexpr int alphabeta_search<board_type>::win;
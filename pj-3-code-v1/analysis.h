@@ -0,0 +1,125 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * analysis.h: The batch analysis of positions with a fixed budget per position
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "options.h"
+#include "threads.h"
+
+/**
+ * the analysis of the positions of an input, one position per line as the moves in SGF, e.g., "(;B[ee];W[cc])",
+ * where the other properties and the empty lines or the lines starting with '#' are ignored
+ *
+ * the positions are searched in parallel by long-lived players (one pair per thread, whose node pools are reused),
+ * each with the budget of the player configuration, e.g., simulation=1000; the results are written in the input order
+ * as soon as they are ready, one line per position with its line number in the input:
+ *   <line>	<best move>	winrate <win rate of the best move>	visits <move>:<visits> ...
+ * where the visits are sorted in descending order, or "<line>	? <reason>" if the position is invalid
+ *
+ * options: thread (the number of parallel searches, all cores by default)
+ */
+template<class board_type>
+class batch_analysis {
+public:
+	batch_analysis(const std::string& config, const std::string& args = "")
+		: config(config), threads(std::max<int>(std::thread::hardware_concurrency(), 1)) {
+		std::map<std::string, std::string> meta = parse_options(args);
+		if (meta.count("thread")) threads = std::max(std::stoi(meta["thread"]), 1);
+	}
+
+	/* analyze the positions of the input, and return the number of positions */
+	size_t run(std::istream& in, std::ostream& out) {
+		size_t lines = 0, count = 0, next = 1; // the lines read, the positions read, and the next position to be written
+		std::map<size_t, std::string> ready; // the results waiting for the earlier positions
+		std::mutex mtx;
+		uint64_t seed = std::random_device()();
+		run_threads(threads, [&](int k) {
+			player<board_type> black("seed=" + std::to_string(seed + k * 2) + " name=black " + config + " role=black");
+			player<board_type> white("seed=" + std::to_string(seed + k * 2 + 1) + " name=white " + config + " role=white");
+			for (;;) {
+				std::string line;
+				size_t id, at;
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					do {
+						if (!std::getline(in, line)) return;
+						at = ++lines;
+						if (line.size() && line.back() == '\r') line.pop_back();
+					} while (line.empty() || line[0] == '#');
+					id = ++count;
+				}
+				std::string result = std::to_string(at) + "\t" + analyze(line, black, white);
+				std::lock_guard<std::mutex> lock(mtx);
+				ready[id] = result;
+				for (auto it = ready.begin(); it != ready.end() && it->first == next; it = ready.erase(it), next++)
+					out << it->second << std::endl;
+			}
+		});
+		return count;
+	}
+
+protected:
+	/* search a position by the player to move, and return its result */
+	std::string analyze(const std::string& line, player<board_type>& black, player<board_type>& white) {
+		board_type state;
+		std::string error = parse(line, state);
+		if (error.size()) return "? " + error;
+		player<board_type>& who = (state.info().who_take_turns == board::black) ? black : white;
+		action move = who.take_action(state);
+		board_type after = state;
+		if (move.apply(after) != board::legal) return "resign";
+
+		const std::vector<int>& visits = who.root_visits();
+		const std::vector<int>& wins = who.root_wins();
+		int best = action::place(move).position<board_type>().i;
+		std::vector<int> order;
+		for (int i = 0; i < board_type::size_n; i++)
+			if (visits[i]) order.push_back(i);
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return visits[a] > visits[b]; });
+		std::stringstream buf;
+		buf << std::fixed << std::setprecision(4) << std::string(typename board_type::point(best)) << "\t" << "winrate ";
+		if (visits[best]) buf << double(wins[best]) / visits[best];
+		else buf << "-"; // not searched by MCTS
+		buf << "\t" << "visits";
+		for (int i : order) buf << " " << std::string(typename board_type::point(i)) << ":" << visits[i];
+		return buf.str();
+	}
+
+	/* play the moves of a line, e.g., "(;B[ee];W[cc])", and return the reason if it is invalid */
+	static std::string parse(const std::string& line, board_type& state) {
+		for (size_t at = line.find(';'); at != std::string::npos; at = line.find(';', at + 1)) {
+			if (line.compare(at + 1, 2, "B[") != 0 && line.compare(at + 1, 2, "W[") != 0) continue; // other properties
+			std::stringstream in(line.substr(at, 6));
+			action::height(in) = board_type::size_y;
+			action::place move;
+			if (line.compare(at + 5, 1, "]") != 0 || !(in >> move)) return "invalid move: " + line.substr(at, 6);
+			int x = line[at + 3] - 'a', y = line[at + 4] - 'a';
+			if (x < 0 || x >= board_type::size_x || y < 0 || y >= board_type::size_y) return "invalid move: " + line.substr(at, 6);
+			if (move.apply(state) != board::legal) return "illegal move: " + line.substr(at, 6);
+		}
+		return "";
+	}
+
+private:
+	std::string config;
+	int threads;
+};
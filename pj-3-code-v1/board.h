@@ -9,26 +9,158 @@
 
 #pragma once
 #include <array>
-#include <list>
+#include <cstdint>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
 #include <utility>
 #include <cmath>
+#include "probe.h"
 
 /**
- * definition for the 9x9 board
+ * the hollow layout of Hollow NoGo
+ * the hollow locations lie on the central cross, 'arm' points on each side starting next to the border
+ * e.g., arm == 2 for the 9x9 board, arm == 1 for the 7x7 board
+ */
+template<unsigned arm>
+struct hollow_cross {
+	static constexpr bool is_hollow(unsigned w, unsigned h, unsigned x, unsigned y) {
+		return (x == w / 2 && ((y >= 1 && y <= arm) || (y + arm + 1 >= h && y + 1 < h)))
+		    || (y == h / 2 && ((x >= 1 && x <= arm) || (x + arm + 1 >= w && x + 1 < w)));
+	}
+};
+
+/**
+ * compile-time index sequence for generating the lookup tables (std::index_sequence is C++14)
+ */
+template<unsigned... i> struct indices {};
+template<class a, class b> struct concat_indices;
+template<unsigned... i, unsigned... j> struct concat_indices<indices<i...>, indices<j...>> {
+	typedef indices<i..., (sizeof...(i) + j)...> type;
+};
+template<unsigned n> struct make_indices /* halved recursively to keep the instantiation depth logarithmic */
+	: concat_indices<typename make_indices<n / 2>::type, typename make_indices<n - n / 2>::type> {};
+template<> struct make_indices<0> { typedef indices<> type; };
+template<> struct make_indices<1> { typedef indices<0> type; };
+
+/**
+ * the geometry of a board with given width, height, and hollow layout
+ *
+ * the neighbors of a point are listed in the order of { left, right, down, up },
+ * where a neighbor outside the board or at a hollow location is replaced by the point itself,
+ * so that the neighbor loops always take 4 iterations and can be fully unrolled
+ *
+ * the border mask of a point marks which of the { left, right, down, up } are borders,
+ * i.e., bit (1 << d) is set if the d-th neighbor is outside the board or hollow
+ *
+ * the surrounding points of the 3x3 patterns extend the neighbors by the diagonals,
+ * in the order of { left, right, down, up, down-left, down-right, up-left, up-right }
+ */
+template<unsigned width, unsigned height, class layout>
+struct board_geometry {
+	static constexpr int size_n = width * height;
+	static constexpr int coord_x(int i) { return i / height; }
+	static constexpr int coord_y(int i) { return i % height; }
+	static constexpr bool is_hollow(int i) { return layout::is_hollow(width, height, coord_x(i), coord_y(i)); }
+	static constexpr int adjacent(int i, int d) {
+		return d == 0 ? (coord_x(i) > 0 ? i - int(height) : -1)
+		     : d == 1 ? (coord_x(i) + 1 < int(width) ? i + int(height) : -1)
+		     : d == 2 ? (coord_y(i) > 0 ? i - 1 : -1)
+		     :          (coord_y(i) + 1 < int(height) ? i + 1 : -1);
+	}
+	static constexpr int neighbor(int i, int d) {
+		return adjacent(i, d) != -1 && !is_hollow(adjacent(i, d)) ? adjacent(i, d) : i;
+	}
+	static constexpr int surround(int i, int k) {
+		return k < 4 ? adjacent(i, k) : adjacent(i, k < 6 ? 2 : 3) != -1 ? adjacent(adjacent(i, k < 6 ? 2 : 3), k % 2) : -1;
+	}
+	static constexpr int around(int i, int k) {
+		return surround(i, k) != -1 && !is_hollow(surround(i, k)) ? surround(i, k) : i;
+	}
+	static constexpr unsigned border(int i) {
+		return (neighbor(i, 0) == i ? 1u : 0u) | (neighbor(i, 1) == i ? 2u : 0u)
+		     | (neighbor(i, 2) == i ? 4u : 0u) | (neighbor(i, 3) == i ? 8u : 0u);
+	}
+};
+
+/**
+ * lookup tables of a board geometry, indexed by (i), by (i * 4 + d) for the neighbors, or by (i * 8 + k) for the surrounding points
+ */
+template<class geometry, class seq = typename make_indices<geometry::size_n>::type> struct board_table;
+template<class geometry, unsigned... i> struct board_table<geometry, indices<i...>> {
+	static constexpr int8_t x[] = { int8_t(geometry::coord_x(i))... };
+	static constexpr int8_t y[] = { int8_t(geometry::coord_y(i))... };
+	static constexpr bool hollow[] = { geometry::is_hollow(i)... };
+	static constexpr uint8_t border[] = { uint8_t(geometry::border(i))... };
+};
+template<class geometry, unsigned... i> constexpr int8_t board_table<geometry, indices<i...>>::x[];
+template<class geometry, unsigned... i> constexpr int8_t board_table<geometry, indices<i...>>::y[];
+template<class geometry, unsigned... i> constexpr bool board_table<geometry, indices<i...>>::hollow[];
+template<class geometry, unsigned... i> constexpr uint8_t board_table<geometry, indices<i...>>::border[];
+
+template<class geometry, class seq = typename make_indices<geometry::size_n * 4>::type> struct neighbor_table;
+template<class geometry, unsigned... i> struct neighbor_table<geometry, indices<i...>> {
+	static constexpr int16_t neighbor[] = { int16_t(geometry::neighbor(i / 4, i % 4))... };
+};
+template<class geometry, unsigned... i> constexpr int16_t neighbor_table<geometry, indices<i...>>::neighbor[];
+
+template<class geometry, class seq = typename make_indices<geometry::size_n * 8>::type> struct around_table;
+template<class geometry, unsigned... i> struct around_table<geometry, indices<i...>> {
+	static constexpr int16_t around[] = { int16_t(geometry::around(i / 8, i % 8))... };
+};
+template<class geometry, unsigned... i> constexpr int16_t around_table<geometry, indices<i...>>::around[];
+
+/**
+ * the types and the rules shared by all board geometries
+ */
+class board_base {
+public:
+	enum piece_type { empty = 0u, black = 1u, white = 2u, hollow = 3u, unknown = -1u };
+	typedef uint32_t cell;
+	struct data {
+		piece_type who_take_turns;
+	};
+	typedef uint64_t score;
+	typedef int reward;
+
+	enum nogo_move_result {
+		legal = reward(0),
+		illegal_turn = reward(-1),
+		illegal_pass = reward(-2),
+		illegal_out_of_range = reward(-3),
+		illegal_not_empty = reward(-4),
+		illegal_suicide = reward(-5),
+		illegal_take = reward(-6),
+	};
+	/* the name of a result of place, e.g., "illegal_suicide" */
+	static const char* result_name(reward result) {
+		static const char* names[] = {
+			"legal",
+			"illegal_turn",
+			"illegal_pass",
+			"illegal_out_of_range",
+			"illegal_not_empty",
+			"illegal_suicide",
+			"illegal_take",
+			"unknown",
+		};
+		return names[std::min(std::max(-result, 0), 7)];
+	}
+};
+
+/**
+ * definition for the board, e.g., the 9x9 board
  * note that there is no column 'I'
  *
  *   A B C D E F G H J
  * 9 + + + + + + + + + 9
- * 8 + + + +   + + + + 8
- * 7 + + + +   + + + + 7
+ * 8 + + + +   + + + + 8
+ * 7 + + + +   + + + + 7
  * 6 + + + + + + + + + 6
- * 5 +     + + +     + 5
+ * 5 +     + + +     + 5
  * 4 + + + + + + + + + 4
- * 3 + + + +   + + + + 3
- * 2 + + + +   + + + + 2
+ * 3 + + + +   + + + + 3
+ * 2 + + + +   + + + + 2
  * 1 + + + + + + + + + 1
  *   A B C D E F G H J
  *
@@ -41,29 +173,27 @@
  *
  * for 9x9 Hollow NoGo, the empty locations are hollow but not empty, cannot be counted as liberty,
  * i.e., there are also borders at the center of the board
+ *
+ * the geometry is given at compile time, see hollow_board and the typedef board below
  */
-class board {
+template<unsigned width, unsigned height, class layout>
+class basic_board : public board_base {
 public:
-	enum size { size_x = 9u, size_y = 9u, hollow_x = 3u, hollow_y = 3u };
-	enum piece_type { empty = 0u, black = 1u, white = 2u, hollow = 3u, unknown = -1u };
-	typedef uint32_t cell;
+	enum size { size_x = width, size_y = height, size_n = width * height };
+	typedef board_geometry<width, height, layout> geometry;
 	typedef std::array<cell, size_y> column;
 	typedef std::array<column, size_x> grid;
-	struct data {
-		piece_type who_take_turns;
-	};
-	typedef uint64_t score;
-	typedef int reward;
 
 public:
-	board() : stone(initial()), attr({piece_type::black}) {}
-	board(const grid& b, const data& d) : stone(b), attr(d) {}
-	board(const board& b) = default;
-	board& operator =(const board& b) = default;
+	basic_board() : stone(initial()), code(initial_code()), key(initial_hash()), attr({piece_type::black}) {}
+	basic_board(const grid& b, const data& d) : stone(b), attr(d) { refresh(); }
+	basic_board(const basic_board& b) = default;
+	basic_board& operator =(const basic_board& b) = default;
 
 	struct point {
 		int x, y, i;
-		point(int i = -1) : x(i != -1 ? i / size_y : -1), y(i != -1 ? i % size_y : -1), i(i) {}
+		point(int i = -1) : x(unsigned(i) < size_n ? table::x[i] : i != -1 ? i / size_y : -1),
+		                    y(unsigned(i) < size_n ? table::y[i] : i != -1 ? i % size_y : -1), i(i) {}
 		point(int x, int y) : x(x), y(y), i(x != -1 && y != -1 ? x * size_y + y : -1) {}
 		point(const std::string& name) : point(
 			name.size() >= 2 && name != "PASS" ? name[0] - (name[0] > 'I' ? 'B' : 'A') : -1,
@@ -77,60 +207,113 @@ public:
 		}
 	};
 
+	/**
+	 * the compile-time lookup tables, see board_geometry for details
+	 */
+	typedef board_table<geometry> table;
+	static int neighbor(int i, int d) { return neighbor_table<geometry>::neighbor[i * 4 + d]; }
+	static unsigned border(int i) { return table::border[i]; }
+	static bool is_hollow(int i) { return table::hollow[i]; }
+	static int around(int i, int k) { return around_table<geometry>::around[i * 8 + k]; }
+
 	operator grid&() { return stone; }
 	operator const grid&() const { return stone; }
 	column& operator [](unsigned x) { return stone[x]; }
 	const column& operator [](unsigned x) const { return stone[x]; }
-	cell& operator ()(unsigned i) { point p(i); return stone[p.x][p.y]; }
-	const cell& operator ()(unsigned i) const { point p(i); return stone[p.x][p.y]; }
+	cell& operator ()(unsigned i) { return stone[table::x[i]][table::y[i]]; }
+	const cell& operator ()(unsigned i) const { return stone[table::x[i]][table::y[i]]; }
 	cell& operator ()(const std::string& move) { point p(move); return stone[p.x][p.y]; }
 	const cell& operator ()(const std::string& move) const { point p(move); return stone[p.x][p.y]; }
 
 	data info() const { return attr; }
 	data info(data dat) { data old = attr; attr = dat; return old; }
 
-public:
-	bool operator ==(const board& b) const { return stone == b.stone; }
-	bool operator < (const board& b) const { return stone <  b.stone; }
-	bool operator !=(const board& b) const { return !(*this == b); }
-	bool operator > (const board& b) const { return b < *this; }
-	bool operator <=(const board& b) const { return !(b < *this); }
-	bool operator >=(const board& b) const { return !(*this < b); }
+	/**
+	 * the 3x3 pattern code of point (i), which is kept up to date by place()
+	 * the 8 surrounding points (see around) take 2 bits each, from the lowest bits in the order of
+	 * { left, right, down, up, down-left, down-right, up-left, up-right },
+	 * where 0 is empty, 1 is black, 2 is white, and 3 is outside the board or hollow
+	 */
+	unsigned pattern(int i) const { return code[i]; }
+
+	/**
+	 * the Zobrist hash of the stones, which is kept up to date by place()
+	 * the keys are fixed for each geometry, so that the hashes are comparable across runs
+	 */
+	uint64_t hash() const { return key; }
+	static uint64_t zobrist(int i, unsigned cell) {
+		static const std::array<uint64_t, size_n * 4> keys = []() {
+			std::array<uint64_t, size_n * 4> keys;
+			uint64_t x = 0x9e3779b97f4a7c15ull * (size_x * 256 + size_y);
+			for (uint64_t& k : keys) { // splitmix64
+				uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+				k = z ^ (z >> 31);
+			}
+			return keys;
+		}();
+		return keys[i * 4 + (cell & 3u)];
+	}
+
+	/**
+	 * recalculate the pattern codes and the hash, only required after the stones are modified without place()
+	 */
+	void refresh() {
+		key = 0;
+		for (int i = 0; i < size_n; i++) key ^= zobrist(i, operator()(i));
+		for (int i = 0; i < size_n; i++) {
+			unsigned c = 0;
+			for (int k = 0; k < 8 && !is_hollow(i); k++) { // the hollow points are left 0, as they are never updated
+				int j = around(i, k);
+				c |= (j != i ? operator()(j) : piece_type::hollow) << (2 * k);
+			}
+			code[i] = c;
+		}
+	}
 
 public:
-	enum nogo_move_result {
-		legal = reward(0),
-		illegal_turn = reward(-1),
-		illegal_pass = reward(-2),
-		illegal_out_of_range = reward(-3),
-		illegal_not_empty = reward(-4),
-		illegal_suicide = reward(-5),
-		illegal_take = reward(-6),
-	};
+	bool operator ==(const basic_board& b) const { return stone == b.stone; }
+	bool operator < (const basic_board& b) const { return stone <  b.stone; }
+	bool operator !=(const basic_board& b) const { return !(*this == b); }
+	bool operator > (const basic_board& b) const { return b < *this; }
+	bool operator <=(const basic_board& b) const { return !(b < *this); }
+	bool operator >=(const basic_board& b) const { return !(*this < b); }
 
+public:
 	/**
 	 * place a stone to the specific position
 	 * who == piece_type::unknown indicates automatically play as the next side
 	 * return nogo_move_result::legal if the action is valid, or nogo_move_result::illegal_* if not
 	 */
 	reward place(int x, int y, unsigned who = piece_type::unknown) {
+		probe::scope timing(probe::in_place);
+		probe::count(probe::legality);
 		if (who == -1u) who = attr.who_take_turns;
 		if (who != attr.who_take_turns) return nogo_move_result::illegal_turn;
 		if (x == -1 && y == -1) return nogo_move_result::illegal_pass;
-		point p_min(0, 0), p_max(size_x - 1, size_y - 1);
-		if (x < p_min.x || x > p_max.x || y < p_min.y || y > p_max.y) return nogo_move_result::illegal_out_of_range;
-		if (board::initial()[x][y] == piece_type::hollow)             return nogo_move_result::illegal_out_of_range;
-		board test = *this;
-		if (test[x][y] != piece_type::empty) return nogo_move_result::illegal_not_empty;
-		test[x][y] = who; // try put a piece first
-		if (test.check_liberty(x, y, who) == 0) return nogo_move_result::illegal_suicide;
+		if (x < 0 || x >= size_x || y < 0 || y >= size_y) return nogo_move_result::illegal_out_of_range;
+		int i = x * size_y + y;
+		if (is_hollow(i))                    return nogo_move_result::illegal_out_of_range;
+		if (stone[x][y] != piece_type::empty) return nogo_move_result::illegal_not_empty;
+		stone[x][y] = who; // try put a piece first
 		unsigned opp = 3u - who;
-		if (x > p_min.x && test.check_liberty(x - 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (x < p_max.x && test.check_liberty(x + 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (y > p_min.y && test.check_liberty(x, y - 1, opp) == 0) return nogo_move_result::illegal_take;
-		if (y < p_max.y && test.check_liberty(x, y + 1, opp) == 0) return nogo_move_result::illegal_take;
-		stone[x][y] = who; // is legal move!
-		attr.who_take_turns = static_cast<piece_type>(opp);
+		reward result = nogo_move_result::legal;
+		if (!has_liberty(i, who)) result = nogo_move_result::illegal_suicide;
+		else if (!has_liberty(neighbor(i, 0), opp)) result = nogo_move_result::illegal_take;
+		else if (!has_liberty(neighbor(i, 1), opp)) result = nogo_move_result::illegal_take;
+		else if (!has_liberty(neighbor(i, 2), opp)) result = nogo_move_result::illegal_take;
+		else if (!has_liberty(neighbor(i, 3), opp)) result = nogo_move_result::illegal_take;
+		if (result != nogo_move_result::legal) {
+			stone[x][y] = piece_type::empty; // revert the trial piece
+			return result;
+		}
+		attr.who_take_turns = static_cast<piece_type>(opp); // is legal move!
+		key ^= zobrist(i, piece_type::empty) ^ zobrist(i, who);
+		for (int k = 0; k < 8; k++) { // the point (i) is the ((k ^ 1) or (k ^ 3))-th surrounding point of its k-th one
+			int j = around(i, k);
+			if (j != i) code[j] |= who << (2 * (k ^ (k < 4 ? 1 : 3)));
+		}
 		return nogo_move_result::legal;
 	}
 	reward place(const point& p, unsigned who = piece_type::unknown) {
@@ -142,42 +325,61 @@ public:
 	 * return >= 0 if [x][y] is placed by who; otherwise return -1
 	 */
 	int check_liberty(int x, int y, unsigned who) const {
-		grid test = stone;
-		if (test[x][y] != who) return -1;
-
-		int liberty = 0;
-		std::list<point> check;
-		for (check.emplace_back(x, y); check.size(); check.pop_front()) {
-			int x = check.front().x, y = check.front().y;
-			test[x][y] = piece_type::unknown; // prevent recalculate
-
-			point p_min(0, 0), p_max(size_x - 1, size_y - 1);
-
-			cell near_l = x > p_min.x ? test[x - 1][y] : -1u; // left
-			if (near_l == piece_type::empty) liberty++;
-			else if (near_l == who) check.emplace_back(x - 1, y);
-
-			cell near_r = x < p_max.x ? test[x + 1][y] : -1u; // right
-			if (near_r == piece_type::empty) liberty++;
-			else if (near_r == who) check.emplace_back(x + 1, y);
-
-			cell near_d = y > p_min.y ? test[x][y - 1] : -1u; // down
-			if (near_d == piece_type::empty) liberty++;
-			else if (near_d == who) check.emplace_back(x, y - 1);
-
-			cell near_u = y < p_max.y ? test[x][y + 1] : -1u; // up
-			if (near_u == piece_type::empty) liberty++;
-			else if (near_u == who) check.emplace_back(x, y + 1);
+		return check_liberty(x * size_y + y, who);
+	}
+	int check_liberty(int i, unsigned who) const {
+		probe::scope timing(probe::in_liberty);
+		if (operator()(i) != who) return -1;
+		std::array<bool, size_n> visit = {}; // prevent recalculate
+		std::array<int16_t, size_n> check;
+		int liberty = 0, n = 0;
+		visit[i] = true;
+		check[n++] = i;
+		for (int k = 0; k < n; k++) {
+			for (int d = 0; d < 4; d++) { // left, right, down, up
+				int near = neighbor(check[k], d);
+				cell type = operator()(near);
+				if (type == piece_type::empty) liberty++;
+				else if (type == who && !visit[near]) visit[near] = true, check[n++] = near;
+			}
 		}
+		probe::count(probe::flood_step, n);
 		return liberty;
 	}
 
+	/**
+	 * check whether the block of piece at (i) has any liberty, stop at the first liberty found
+	 * return true if (i) is not placed by who
+	 */
+	bool has_liberty(int i, unsigned who) const {
+		if (operator()(i) != who) return true;
+		std::array<bool, size_n> visit = {};
+		std::array<int16_t, size_n> check;
+		int n = 0;
+		visit[i] = true;
+		check[n++] = i;
+		for (int k = 0; k < n; k++) {
+			for (int d = 0; d < 4; d++) { // left, right, down, up
+				int near = neighbor(check[k], d);
+				cell type = operator()(near);
+				if (type == piece_type::empty) {
+					probe::count(probe::flood_step, k + 1);
+					return true;
+				}
+				if (type == who && !visit[near]) visit[near] = true, check[n++] = near;
+			}
+		}
+		probe::count(probe::flood_step, n);
+		return false;
+	}
+
 	void transpose() {
 		for (int x = 0; x < size_x; x++) {
 			for (int y = x + 1; y < size_y; y++) {
 				std::swap(stone[x][y], stone[y][x]);
 			}
 		}
+		refresh();
 	}
 
 	void reflect_horizontal() {
@@ -186,6 +388,7 @@ public:
 				std::swap(stone[x][y], stone[size_x - 1 - x][y]);
 			}
 		}
+		refresh();
 	}
 
 	void reflect_vertical() {
@@ -194,6 +397,7 @@ public:
 				std::swap(stone[x][y], stone[x][size_y - 1 - y]);
 			}
 		}
+		refresh();
 	}
 
 	/**
@@ -214,7 +418,7 @@ public:
 	void reverse() { reflect_horizontal(); reflect_vertical(); }
 
 public:
-	friend std::ostream& operator <<(std::ostream& out, const board& b) {
+	friend std::ostream& operator <<(std::ostream& out, const basic_board& b) {
 		std::ios ff(nullptr);
 		ff.copyfmt(out); // make a copy of the original print format
 
@@ -243,7 +447,7 @@ public:
 		out.copyfmt(ff); // restore print format
 		return out;
 	}
-	friend std::istream& operator >>(std::istream& in, board& b) {
+	friend std::istream& operator >>(std::istream& in, basic_board& b) {
 		std::string token;
 		for (int x = 0; x < size_x; x++) in >> token; /* skip X */
 		for (int y = size_y - 1; y >= 0 && in >> token /* skip Y */; in >> token /* skip Y */, y--) {
@@ -262,6 +466,7 @@ public:
 			}
 		}
 		for (int x = 0; x < size_x; x++) in >> token; /* skip X */
+		b.refresh();
 		return in;
 	}
 	friend std::ostream& operator <<(std::ostream& out, const point& p) {
@@ -274,19 +479,32 @@ public:
 	}
 
 protected:
-	static const grid& initial() { static grid stone; return stone; }
-	static __attribute__((constructor)) void init_initial_scheme() {
-		grid& stone = const_cast<grid&>(initial());
-		stone[4][1] = piece_type::hollow;
-		stone[4][2] = piece_type::hollow;
-		stone[4][6] = piece_type::hollow;
-		stone[4][7] = piece_type::hollow;
-		stone[1][4] = piece_type::hollow;
-		stone[2][4] = piece_type::hollow;
-		stone[6][4] = piece_type::hollow;
-		stone[7][4] = piece_type::hollow;
+	static const grid& initial() {
+		static const grid stone = []() {
+			grid stone = {};
+			for (int i = 0; i < size_n; i++)
+				if (is_hollow(i)) stone[table::x[i]][table::y[i]] = piece_type::hollow;
+			return stone;
+		}();
+		return stone;
+	}
+	static const std::array<uint16_t, size_n>& initial_code() {
+		static const std::array<uint16_t, size_n> code = basic_board(initial(), {piece_type::black}).code;
+		return code;
+	}
+	static uint64_t initial_hash() {
+		static const uint64_t key = basic_board(initial(), {piece_type::black}).key;
+		return key;
 	}
 private:
 	grid stone;
+	std::array<uint16_t, size_n> code;
+	uint64_t key;
 	data attr;
 };
+
+/**
+ * Hollow NoGo boards of the prebuilt sizes
+ */
+template<unsigned size> using hollow_board = basic_board<size, size, hollow_cross<(size - 3) / 3>>;
+typedef hollow_board<9> board;
@@ -0,0 +1,168 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * check.h: The parallel validator of the games in SGF files and episode logs
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+#include "board.h"
+#include "options.h"
+#include "threads.h"
+
+/**
+ * the validator which replays the games of the files in parallel, and reports the first illegal move of each game
+ * with the reason of board::place, e.g., illegal_suicide, followed by a summary
+ *
+ * a file (or - for stdin) holds any number of games in SGF, e.g., the episodes saved by --save, one game per "(...)";
+ * a file without any "(" is a single game, e.g., the moves extracted by grep -Eo ";[BW]\[[a-i][a-i]\]"
+ * the moves are the nodes ";B[..]" and ";W[..]", where "B[]" is a pass; the size is checked if SZ is given
+ *
+ * the games of all files are checked in parallel, and only the illegal ones are reported in the order of the files, e.g.,
+ *   game.sgf:2	moves = 41	illegal_suicide at move 42 ;W[cc]
+ * options: thread (the number of threads, all cores by default)
+ */
+template<class board_type>
+class game_checker {
+public:
+	struct result {
+		size_t moves = 0;                    /* the legal moves before the first illegal one */
+		board::reward code = board::legal;   /* the result of the first illegal move, or legal */
+		std::string move;                    /* the first illegal move, e.g., ";W[cc]", or the invalid SZ */
+		board::piece_type who = board::empty; /* the player of the first illegal move */
+	};
+
+	game_checker(const std::string& args = "") : threads(std::max<int>(std::thread::hardware_concurrency(), 1)) {
+		std::map<std::string, std::string> meta = parse_options(args);
+		if (meta.count("thread")) threads = std::max(std::stoi(meta["thread"]), 1);
+	}
+
+	/* check the games of the files, and return the number of the illegal games and the unreadable files */
+	size_t run(const std::vector<std::string>& files, std::ostream& out) {
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::vector<std::string>> texts(files.size());
+		std::vector<char> readable(files.size());
+		parallel(files.size(), [&](size_t f) { readable[f] = read(files[f], texts[f]); });
+
+		// the games are the tasks, so that a single large log is also checked in parallel
+		std::vector<std::pair<size_t, size_t>> games; // the file and the game of each task
+		for (size_t f = 0; f < files.size(); f++)
+			for (size_t g = 0; g < texts[f].size(); g++) games.emplace_back(f, g);
+		std::vector<result> results(games.size());
+		parallel(games.size(), [&](size_t k) { results[k] = check(texts[games[k].first][games[k].second]); });
+
+		size_t moves = 0, failures = 0, illegal[3] = {};
+		for (size_t k = 0, f = 0; f < files.size(); f++) {
+			for (; k < games.size() && games[k].first == f; k++) {
+				const result& r = results[k];
+				moves += r.moves;
+				if (r.code == board::legal) continue;
+				illegal[r.who == board::white ? 2 : r.who == board::black ? 1 : 0]++;
+				out << files[f] << ":" << (games[k].second + 1) << "\t" << "moves = " << r.moves << "\t"
+				    << board::result_name(r.code) << " at move " << (r.moves + 1) << " " << r.move << std::endl;
+			}
+			if (!readable[f]) out << files[f] << "\t" << "cannot open the file" << std::endl, failures++;
+		}
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		size_t invalid = illegal[0] + illegal[1] + illegal[2];
+		out << "files = " << files.size() << (failures ? " (" + std::to_string(failures) + " unreadable)" : "") << ", "
+		    << "games = " << games.size() << ", " << "legal = " << (games.size() - invalid) << ", "
+		    << "illegal = " << invalid << " (B " << illegal[1] << ", W " << illegal[2] << ", other " << illegal[0] << "), "
+		    << "moves = " << moves << ", " << "time = " << elapsed << "s" << std::endl;
+		return invalid + failures;
+	}
+
+	/* replay the moves of a game, and return the first illegal move if any */
+	static result check(const std::string& game) {
+		result r;
+		board_type state;
+		size_t at = find(game, "SZ[");
+		if (at != std::string::npos) { // e.g., SZ[9], or SZ[9:9] for the columns and the rows
+			std::string size = game.substr(at + 3, game.find(']', at) - at - 3);
+			std::string y = size.substr(0, size.find(':')), x = size.substr(size.find(':') + 1);
+			if (y != std::to_string(board_type::size_y) || x != std::to_string(board_type::size_x)) {
+				r.code = board::illegal_out_of_range;
+				r.move = "SZ[" + size + "]";
+				return r;
+			}
+		}
+		for (at = 0; (at = find(game, ";", at)) != std::string::npos; at++) {
+			size_t i = game.find_first_not_of(" \t\r\n", at + 1);
+			if (i == std::string::npos || (game[i] != 'B' && game[i] != 'W') || game.compare(i + 1, 1, "[") != 0) continue;
+			size_t end = game.find(']', i);
+			if (end == std::string::npos) break;
+			std::string value = game.substr(i + 2, end - i - 2);
+			unsigned who = (game[i] == 'B') ? board::black : board::white;
+			int x = -1, y = -1; // a pass if empty
+			if (value.size() == 2) x = value[0] - 'a', y = (board_type::size_y - 1) - (value[1] - 'a');
+			else if (value.size()) x = y = board_type::size_x + board_type::size_y; // out of range
+			board::reward code = state.place(x, y, who);
+			if (code != board::legal) {
+				r.code = code;
+				r.move = ";" + game.substr(i, end - i + 1);
+				r.who = board::piece_type(who);
+				return r;
+			}
+			r.moves++;
+		}
+		return r;
+	}
+
+protected:
+	/* read the games of a file, each of which is a "(...)", or the whole file if there is none */
+	static bool read(const std::string& path, std::vector<std::string>& games) {
+		std::ifstream file;
+		if (path != "-") file.open(path);
+		if (path != "-" && !file.is_open()) return false;
+		std::istream& in = (path != "-") ? file : std::cin;
+		std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		int depth = 0;
+		size_t open = 0;
+		for (size_t i = 0; i < text.size(); i++) {
+			if (text[i] == '[') i = skip(text, i);
+			else if (text[i] == '(' && depth++ == 0) open = i;
+			else if (text[i] == ')' && depth > 0 && --depth == 0) games.push_back(text.substr(open, i - open + 1));
+		}
+		if (games.empty() && text.find('(') == std::string::npos && text.find(';') != std::string::npos)
+			games.push_back(text);
+		return true;
+	}
+
+	/* run the tasks 0 to n - 1 on the threads */
+	void parallel(size_t n, std::function<void(size_t)> task) const {
+		std::atomic<size_t> next{0};
+		run_threads(std::min<size_t>(threads, n), [&](int) { for (size_t i; (i = next++) < n; ) task(i); });
+	}
+
+	/* the position of the ']' which closes the property value at the '[' */
+	static size_t skip(const std::string& text, size_t i) {
+		for (i++; i < text.size() && text[i] != ']'; i++)
+			if (text[i] == '\\') i++;
+		return i;
+	}
+
+	/* find the token outside the property values */
+	static size_t find(const std::string& text, const std::string& token, size_t from = 0) {
+		for (size_t i = from; i < text.size(); i++) {
+			if (text.compare(i, token.size(), token) == 0) return i;
+			if (text[i] == '[') i = skip(text, i);
+		}
+		return std::string::npos;
+	}
+
+private:
+	int threads;
+};
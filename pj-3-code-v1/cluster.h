@@ -0,0 +1,387 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * cluster.h: The search cluster of local processes sharing a transposition table in shared memory
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "options.h"
+
+extern char** environ;
+
+/**
+ * the transposition table of the position statistics, which is lock-free and can be shared by processes:
+ * an entry is claimed by a compare-and-swap of its key, and its visits and wins are packed in one word,
+ * so that an update is a single fetch-and-add, and a read always sees a consistent pair
+ * a key is probed in a few consecutive entries, and the position is not shared if they are all taken
+ */
+class transposition_table {
+public:
+	struct entry {
+		std::atomic<uint64_t> key;   /* 0 for an empty entry */
+		std::atomic<uint64_t> stats; /* visits << 32 | wins */
+	};
+
+	transposition_table(entry* entries = nullptr, size_t capacity = 0, std::atomic<uint64_t>* used = nullptr)
+		: entries(entries), mask(capacity - 1), used(used) {}
+
+	/* add the visits and the wins of the position, which may be negative, and return false if it is not shared */
+	bool add(uint64_t key, int visits, int wins) {
+		entry* e = find(key, true);
+		if (e == nullptr) return false;
+		e->stats.fetch_add((uint64_t(int64_t(visits)) << 32) + uint64_t(int64_t(wins)), std::memory_order_relaxed);
+		return true;
+	}
+
+	/* read the visits and the wins of the position, and return false if it is not found */
+	bool get(uint64_t key, int& visits, int& wins) const {
+		const entry* e = find(key, false);
+		if (e == nullptr) return false;
+		uint64_t stats = e->stats.load(std::memory_order_relaxed);
+		visits = int(stats >> 32), wins = int(uint32_t(stats));
+		return true;
+	}
+
+	size_t capacity() const { return mask + 1; }
+	size_t size() const { return used->load(std::memory_order_relaxed); }
+
+	/* empty the table, which should be done while no one is searching */
+	void clear() {
+		for (size_t i = 0; i <= mask; i++) {
+			entries[i].stats.store(0, std::memory_order_relaxed);
+			entries[i].key.store(0, std::memory_order_release);
+		}
+		used->store(0, std::memory_order_relaxed);
+	}
+
+private:
+	entry* find(uint64_t key, bool claim) const {
+		key = key ? key : 1;
+		for (size_t i = 0; i < probes; i++) {
+			entry& e = entries[(key + i) & mask];
+			uint64_t k = e.key.load(std::memory_order_acquire);
+			if (k == key) return &e;
+			if (k != 0) continue;
+			if (claim == false) return nullptr;
+			if (e.key.compare_exchange_strong(k, key)) {
+				used->fetch_add(1, std::memory_order_relaxed);
+				return &e;
+			}
+			if (k == key) return &e; // claimed by another process at the same time
+		}
+		return nullptr;
+	}
+
+	static constexpr size_t probes = 8;
+	entry* entries;
+	size_t mask;
+	std::atomic<uint64_t>* used;
+};
+
+/**
+ * the shared memory of a cluster, which consists of a header (the job posted by the coordinator), a slot of results
+ * for each worker, and the transposition table
+ *
+ * a job is published by a sequence lock: its number is odd while the coordinator is writing, and is even when ready,
+ * and a worker reports the job by writing the visits and wins of the root children to its slot and then the number
+ */
+template<class board_type>
+class cluster_segment {
+public:
+	struct header {
+		char magic[8];
+		uint32_t size_x, size_y, workers;
+		uint64_t capacity;                 /* the entries of the table, a power of two */
+		std::atomic<int> owner;            /* the pid of the coordinator */
+		std::atomic<int> quit;
+		std::atomic<uint64_t> job, stop;   /* the number of the posted job, and of the last job stopped */
+		std::atomic<uint64_t> used;        /* the entries of the table in use */
+		typename board_type::grid stones;  /* the position of the job */
+		board::data info;
+		int32_t who, endless;              /* the player to move, and whether to search until being stopped */
+		char config[4096];                 /* the player configuration of the workers */
+	};
+	struct slot {
+		std::atomic<int> pid;
+		std::atomic<uint64_t> done;        /* the number of the last job reported */
+		int32_t visits[board_type::size_n], wins[board_type::size_n];
+	};
+
+	/* create a segment of the workers and the entries, or attach the existing one if workers is zero */
+	cluster_segment(const std::string& name, size_t workers = 0, size_t capacity = 0) : name(name), base(MAP_FAILED), size(0), owned(workers) {
+		int fd = ::shm_open(name.c_str(), owned ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+		if (fd < 0) throw std::runtime_error("cannot open shared memory " + name + ": " + std::strerror(errno));
+		if (owned) {
+			size = offset(workers, capacity);
+			if (::ftruncate(fd, size) != 0) {
+				::close(fd), ::shm_unlink(name.c_str());
+				throw std::runtime_error("cannot allocate shared memory " + name + ": " + std::strerror(errno));
+			}
+		} else {
+			struct stat st;
+			size = (::fstat(fd, &st) == 0) ? st.st_size : 0;
+		}
+		if (size >= sizeof(header)) base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (base == MAP_FAILED) {
+			if (owned) ::shm_unlink(name.c_str());
+			throw std::runtime_error("cannot map shared memory " + name);
+		}
+		header& h = *static_cast<header*>(base);
+		if (owned) { // the memory is zeroed by ftruncate
+			std::memcpy(h.magic, "NOGOCLUS", 8);
+			h.size_x = board_type::size_x, h.size_y = board_type::size_y;
+			h.workers = workers, h.capacity = capacity;
+			h.owner = ::getpid();
+		} else if (std::memcmp(h.magic, "NOGOCLUS", 8) != 0 || h.size_x != board_type::size_x || h.size_y != board_type::size_y
+				|| offset(h.workers, h.capacity) > size) {
+			::munmap(base, size);
+			throw std::invalid_argument("incompatible shared memory: " + name);
+		}
+		shared = transposition_table(entries(), h.capacity, &h.used);
+	}
+	cluster_segment(const cluster_segment&) = delete;
+	~cluster_segment() {
+		::munmap(base, size);
+		if (owned) ::shm_unlink(name.c_str());
+	}
+
+	header& info() { return *static_cast<header*>(base); }
+	slot& at(size_t k) { return reinterpret_cast<slot*>(static_cast<char*>(base) + align(sizeof(header)))[k]; }
+	transposition_table& table() { return shared; }
+	const std::string& path() const { return name; }
+
+private:
+	static size_t align(size_t n) { return (n + 63) / 64 * 64; }
+	static size_t offset(size_t workers, size_t capacity) {
+		return align(sizeof(header)) + align(sizeof(slot) * workers) + sizeof(transposition_table::entry) * capacity;
+	}
+	transposition_table::entry* entries() {
+		header& h = info();
+		return reinterpret_cast<transposition_table::entry*>(static_cast<char*>(base) + offset(h.workers, 0));
+	}
+
+	std::string name;
+	void* base;
+	size_t size;
+	bool owned;
+	transposition_table shared;
+};
+
+/**
+ * the coordinator of a cluster, which launches the workers as local processes of this program (nogo --worker),
+ * posts the position of each search to them, and gathers their results of the root children
+ *
+ * the workers exchange the statistics of the positions with the coordinator by the table during the searches,
+ * and a worker which exits is reported and relaunched at the next search, so that a crash only loses its results
+ */
+template<class board_type>
+class search_cluster {
+public:
+	/* launch the workers of the configuration, with the table of the size in megabytes, and the grace in milliseconds */
+	search_cluster(size_t workers, const std::string& config, size_t megabytes = 64, int grace = 1000)
+		: memory(segment_name(), std::max<size_t>(workers, 1), table_capacity(megabytes)),
+		  pids(std::max<size_t>(workers, 1), 0), grace(grace), next(0) {
+		if (config.size() >= sizeof(memory.info().config)) throw std::invalid_argument("too long configuration: " + config);
+		std::strcpy(memory.info().config, config.c_str());
+		for (size_t k = 0; k < pids.size(); k++) launch(k);
+	}
+	search_cluster(const search_cluster&) = delete;
+	~search_cluster() {
+		memory.info().quit = 1;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+		for (size_t k = 0; k < pids.size(); k++) {
+			while (pids[k] > 0 && ::waitpid(pids[k], nullptr, WNOHANG) == 0) {
+				if (std::chrono::steady_clock::now() > deadline) ::kill(pids[k], SIGKILL);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	transposition_table& table() { return memory.table(); }
+	size_t workers() const { return pids.size(); }
+
+	/* post the position to the workers, relaunching the ones which exited, and return the number of the job */
+	uint64_t post(const board_type& state, board::piece_type who, bool endless) {
+		typename cluster_segment<board_type>::header& h = memory.info();
+		for (size_t k = 0; k < pids.size(); k++)
+			if (alive(k) == false) launch(k);
+		if (table().size() > table().capacity() / 2) table().clear(); // the stale workers may still add a few
+		h.job.store(next + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		h.stones = (const typename board_type::grid&)state;
+		h.info = state.info();
+		h.who = who, h.endless = endless;
+		h.job.store(next += 2, std::memory_order_release);
+		return next;
+	}
+
+	/**
+	 * wait for the results of the job, and add the visits and wins of the root children of the workers by the moves
+	 * the workers are stopped at once if asked, or after the grace otherwise; the ones which are not done within
+	 * the grace after being stopped are left out; return the number of the workers whose results are added
+	 */
+	size_t gather(uint64_t job, std::vector<int>& visits, std::vector<int>& wins, bool stop) {
+		typename cluster_segment<board_type>::header& h = memory.info();
+		if (stop) h.stop = job;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(grace);
+		for (;;) {
+			size_t pending = 0;
+			for (size_t k = 0; k < pids.size(); k++)
+				pending += (memory.at(k).done.load(std::memory_order_acquire) != job && alive(k));
+			if (pending == 0) break;
+			if (std::chrono::steady_clock::now() > deadline) {
+				if (stop) break;
+				h.stop = job, stop = true;
+				deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(grace);
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		h.stop = job;
+		size_t count = 0;
+		for (size_t k = 0; k < pids.size(); k++) {
+			typename cluster_segment<board_type>::slot& s = memory.at(k);
+			if (s.done.load(std::memory_order_acquire) != job) continue;
+			for (int i = 0; i < board_type::size_n; i++) visits[i] += s.visits[i], wins[i] += s.wins[i];
+			count++;
+		}
+		return count;
+	}
+
+protected:
+	/* launch the worker k as "nogo --board=<size> --worker=<segment> slot=k", with the standard input and output closed */
+	void launch(size_t k) {
+		std::string board = "--board=" + std::to_string(board_type::size_x);
+		std::string worker = "--worker=" + memory.path() + " slot=" + std::to_string(k);
+		char* argv[] = { const_cast<char*>("nogo"), &board[0], &worker[0], nullptr };
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init(&actions);
+		posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+		posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+		pid_t pid = 0;
+		int error = posix_spawn(&pid, "/proc/self/exe", &actions, nullptr, argv, environ);
+		posix_spawn_file_actions_destroy(&actions);
+		if (error != 0) throw std::runtime_error(std::string("cannot launch worker: ") + std::strerror(error));
+		pids[k] = pid;
+	}
+
+	/* whether the worker k is running, where the one which exited is reported */
+	bool alive(size_t k) {
+		if (pids[k] <= 0) return false;
+		int status = 0;
+		if (::waitpid(pids[k], &status, WNOHANG) == 0) return true;
+		std::cerr << "cluster: worker " << k << " (pid " << pids[k] << ") ";
+		if (WIFSIGNALED(status)) std::cerr << "killed by signal " << WTERMSIG(status) << std::endl;
+		else std::cerr << "exited with status " << WEXITSTATUS(status) << std::endl;
+		pids[k] = 0;
+		return false;
+	}
+
+	static std::string segment_name() {
+		static std::atomic<int> count{0};
+		return "/nogo-" + std::to_string(::getpid()) + "-" + std::to_string(count++);
+	}
+	static size_t table_capacity(size_t megabytes) {
+		size_t capacity = 1024;
+		while (capacity * 2 * sizeof(transposition_table::entry) <= megabytes * 1048576) capacity *= 2;
+		return capacity;
+	}
+
+private:
+	cluster_segment<board_type> memory;
+	std::vector<pid_t> pids;
+	int grace;
+	uint64_t next;
+};
+
+/**
+ * the worker of a cluster, which attaches the shared memory, and searches the posted positions with the players
+ * of the configuration of the coordinator until the coordinator quits or exits
+ *
+ * the arguments are "<segment> slot=<k>", see search_cluster::launch
+ */
+template<class board_type, class player_type>
+class cluster_worker {
+public:
+	cluster_worker(const std::string& args) : index(0) {
+		std::stringstream ss(args);
+		ss >> name;
+		std::map<std::string, std::string> meta = parse_options(ss);
+		if (meta.count("slot")) index = std::stoul(meta["slot"]);
+	}
+
+	int run() {
+		cluster_segment<board_type> memory(name);
+		typename cluster_segment<board_type>::header& h = memory.info();
+		if (index >= h.workers) throw std::invalid_argument("invalid slot: " + std::to_string(index));
+		typename cluster_segment<board_type>::slot& s = memory.at(index);
+		s.pid = ::getpid();
+		std::string config = "name=worker-" + std::to_string(index) + " " + std::string(h.config);
+		player_type black(config + " role=black"), white(config + " role=white");
+		black.join(&memory.table()), white.join(&memory.table());
+
+		auto running = [&]() { return h.quit == 0 && (::kill(h.owner, 0) == 0 || errno != ESRCH); };
+		for (uint64_t last = 0; running(); ) {
+			uint64_t job = h.job.load(std::memory_order_acquire);
+			if ((job & 1) || job == last) {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+				continue;
+			}
+			board_type state(h.stones, h.info);
+			bool endless = h.endless;
+			player_type& who = (h.who == board::black) ? black : white;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (h.job.load(std::memory_order_relaxed) != job) continue; // rewritten while being read
+			last = job;
+			if (h.stop.load() >= job) continue; // already gathered
+
+			std::atomic<bool> searching{true};
+			std::thread watcher([&]() {
+				for (int n = 1; searching; n++) {
+					if (h.stop.load() >= job || (n % 256 == 0 && !running())) return who.interrupt();
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+			});
+			if (endless) who.analyze(state, nullptr);
+			else who.take_action(state);
+			searching = false;
+			watcher.join();
+			who.interrupt(false);
+
+			const std::vector<int>& visits = who.root_visits();
+			const std::vector<int>& wins = who.root_wins();
+			std::copy(visits.begin(), visits.end(), s.visits);
+			std::copy(wins.begin(), wins.end(), s.wins);
+			s.done.store(job, std::memory_order_release);
+		}
+		if (h.quit == 0) ::shm_unlink(name.c_str()); // the coordinator exited without removing it
+		return 0;
+	}
+
+private:
+	std::string name;
+	size_t index;
+};
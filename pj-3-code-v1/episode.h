@@ -19,15 +19,16 @@
 #include "action.h"
 #include "agent.h"
 
+template<class board_type = board>
 class episode {
 public:
 	episode() : ep_state(initial_state()), ep_score(0), ep_time(0) {
-		ep_moves.reserve(board::size_x * board::size_y);
+		ep_moves.reserve(board_type::size_n);
 	}
 
 public:
-	board& state() { return ep_state; }
-	const board& state() const { return ep_state; }
+	board_type& state() { return ep_state; }
+	const board_type& state() const { return ep_state; }
 	board::score score() const { return ep_score; }
 
 	void open_episode(const std::string& tag) {
@@ -39,15 +40,15 @@ public:
 	bool apply_action(action move) {
 		board::reward reward = move.apply(state());
 		if (reward != board::legal) return false;
-		ep_moves.emplace_back(move, reward, millisec() - ep_time);
+		ep_moves.emplace_back(move, reward, microsec() - ep_time);
 		ep_score += reward;
 		return true;
 	}
-	agent& take_turns(agent& black, agent& white) {
-		ep_time = millisec();
+	agent<board_type>& take_turns(agent<board_type>& black, agent<board_type>& white) {
+		ep_time = microsec();
 		return (step() % 2) ? white : black;
 	}
-	agent& last_turns(agent& black, agent& white) {
+	agent<board_type>& last_turns(agent<board_type>& black, agent<board_type>& white) {
 		return take_turns(white, black);
 	}
 
@@ -69,11 +70,13 @@ public:
 		switch (who) {
 		case board::black:
 		case action::black::type:
-			for (size_t i = 0; i < ep_moves.size(); i += 2) time += ep_moves[i].time;
+			for (size_t i = 0; i < ep_moves.size(); i += 2) time += ep_moves[i].latency;
+			time /= 1000;
 			break;
 		case board::white:
 		case action::white::type:
-			for (size_t i = 1; i < ep_moves.size(); i += 2) time += ep_moves[i].time;
+			for (size_t i = 1; i < ep_moves.size(); i += 2) time += ep_moves[i].latency;
+			time /= 1000;
 			break;
 		case action::place::type:
 		default:
@@ -83,6 +86,9 @@ public:
 		return time;
 	}
 
+	/* the latency of the k-th move in microseconds, from a steady clock (in milliseconds for the loaded episodes) */
+	time_t latency(size_t k) const { return ep_moves[k].latency; }
+
 	std::vector<action> actions(unsigned who = -1u) const {
 		std::vector<action> res;
 		switch (who) {
@@ -107,8 +113,8 @@ public:
 	friend std::ostream& operator <<(std::ostream& out, const episode& ep) {
 		out << '(';
 		out << ";FF[4]CA[UTF-8]AP[TCG-NoGo-Demo]";
-		out << "SZ[" << board::size_y;
-		if (board::size_x != board::size_y) out << ':' << board::size_x;
+		out << "SZ[" << board_type::size_y;
+		if (board_type::size_x != board_type::size_y) out << ':' << board_type::size_x;
 		out << "]KM[0]";
 		std::string names = ep.ep_open.tag;
 		out << "PB[" << names.substr(0, names.find(':')) << "]";
@@ -118,7 +124,10 @@ public:
 		std::string winner = ep.ep_close.tag;
 		out << "RE[" << (names.find(winner) == 0 ? "B" : "W") << "+R]";
 		out << "C[TCG|" << ep.ep_open << "|" << ep.ep_close << "]";
+		long height = action::height(out);
+		action::height(out) = board_type::size_y;
 		for (const move& mv : ep.ep_moves) out << mv;
+		action::height(out) = height;
 		out << ')';
 		return out;
 	}
@@ -129,6 +138,7 @@ public:
 		token.erase(0, token.find('(') + 1);
 		if (token.find("C[TCG|") != std::string::npos) {
 			std::stringstream ss(token.substr(token.find("C[TCG|")));
+			action::height(ss) = board_type::size_y;
 			ss.ignore(6); // C[TCG|
 			ss >> ep.ep_open;
 			ss.ignore(1); // |
@@ -151,8 +161,10 @@ protected:
 	struct move {
 		action code;
 		board::reward reward;
-		time_t time;
-		move(action code = {}, board::reward reward = 0, time_t time = 0) : code(code), reward(reward), time(time) {}
+		time_t time;    /* in milliseconds, which is saved */
+		time_t latency; /* in microseconds */
+		move(action code = {}, board::reward reward = 0, time_t latency = 0)
+			: code(code), reward(reward), time((latency + 500) / 1000), latency(latency) {}
 
 		operator action() const { return code; }
 		friend std::ostream& operator <<(std::ostream& out, const move& m) {
@@ -169,6 +181,7 @@ protected:
 				in >> std::dec >> m.time;
 				in.ignore(1); // ]
 			}
+			m.latency = m.time * 1000;
 			return in;
 		}
 	};
@@ -186,9 +199,13 @@ protected:
 		}
 	};
 
-	static board initial_state() {
+	static board_type initial_state() {
 		return {};
 	}
+	static time_t microsec() {
+		auto now = std::chrono::steady_clock::now().time_since_epoch();
+		return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+	}
 	static time_t millisec() {
 		auto now = std::chrono::system_clock::now().time_since_epoch();
 		return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
@@ -240,10 +257,10 @@ protected:
 
 	/******************* debug tools  *************************/
 private:
-	board ep_state;
+	board_type ep_state;
 	board::score ep_score;
 	std::vector<move> ep_moves;
-	time_t ep_time;
+	time_t ep_time; /* the steady time when the current move started, in microseconds */
 
 	meta ep_open;
 	meta ep_close;
@@ -0,0 +1,117 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * gtp.h: Utilities for the asynchronous GTP shell
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+
+/**
+ * read the GTP commands from a stream with a background thread
+ *
+ * the commands are queued and popped in order, so that the responses remain ordered; only "stop" takes effect
+ * as soon as it is read, and it stops the command before it: if that command is the current one (the last popped),
+ * the interrupt hook is called with true at once, e.g., to interrupt an ongoing search, otherwise the hook is called
+ * with true when that command is popped; each pop calls the hook with whether the popped command is stopped,
+ * and the hook is always called under the lock of the queue, so that a stop is never lost or misplaced
+ *
+ * the reader thread is detached by default, since it may be blocked by the stream when the shell quits, and it owns
+ * the queue together with the reader, so that the commands read later go nowhere, and the hook is no longer called;
+ * otherwise it is joined when destroyed, for a stream which is closed by the owner first, e.g., a socket
+ */
+class command_reader {
+public:
+	command_reader(std::istream& in, std::function<void(bool)> interrupt = {}, bool detach = true)
+		: line(std::make_shared<channel>()) {
+		line->interrupt = interrupt;
+		reader = std::thread(&command_reader::read, std::ref(in), line);
+		if (detach) reader.detach();
+	}
+	~command_reader() {
+		{
+			std::lock_guard<std::mutex> lock(line->mtx);
+			line->interrupt = nullptr;
+		}
+		if (reader.joinable()) reader.join();
+	}
+
+	/**
+	 * pop the next command, block until a command is available
+	 * return false if the stream is closed and all commands are popped
+	 */
+	bool pop(std::string& command) {
+		std::unique_lock<std::mutex> lock(line->mtx);
+		line->cv.wait(lock, [this]() { return line->queue.size() || line->closed; });
+		if (line->queue.empty()) return false;
+		command = line->queue.front().command;
+		line->stopped = line->queue.front().stopped;
+		line->queue.pop_front();
+		if (line->interrupt) line->interrupt(line->stopped);
+		return true;
+	}
+
+	/**
+	 * wait until a command is available or the stream is closed, without popping it
+	 */
+	void wait() {
+		std::unique_lock<std::mutex> lock(line->mtx);
+		line->cv.wait(lock, [this]() { return line->queue.size() || line->closed; });
+	}
+
+	/**
+	 * call the interrupt hook again with whether the current command is stopped,
+	 * e.g., after the shell has interrupted the players by itself to end an analysis
+	 */
+	void restore() {
+		std::lock_guard<std::mutex> lock(line->mtx);
+		if (line->interrupt) line->interrupt(line->stopped);
+	}
+
+protected:
+	struct pending {
+		std::string command;
+		bool stopped; /* whether a stop of this command has been read */
+	};
+	struct channel {
+		std::deque<pending> queue;
+		std::function<void(bool)> interrupt;
+		std::mutex mtx;
+		std::condition_variable cv;
+		bool stopped = false; /* whether the current command is stopped */
+		bool closed = false;
+	};
+
+	static void read(std::istream& in, std::shared_ptr<channel> line) {
+		for (std::string command; std::getline(in, command); ) {
+			if (command.size() && command.back() == '\r') command.pop_back();
+			if (command.empty()) continue;
+			std::lock_guard<std::mutex> lock(line->mtx);
+			if (command == "stop" && line->queue.size()) {
+				line->queue.back().stopped = true;
+			} else if (command == "stop" && !line->stopped) {
+				line->stopped = true;
+				if (line->interrupt) line->interrupt(true);
+			}
+			line->queue.push_back({ command, false });
+			line->cv.notify_all();
+		}
+		std::lock_guard<std::mutex> lock(line->mtx);
+		line->closed = true;
+		line->cv.notify_all();
+	}
+
+private:
+	std::shared_ptr<channel> line;
+	std::thread reader;
+};
@@ -0,0 +1,162 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * match.h: In-process matches between two player configurations with SPRT early stopping
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include "board.h"
+#include "agent.h"
+#include "episode.h"
+#include "options.h"
+#include "threads.h"
+
+/**
+ * the sequential probability ratio test of H0: elo = elo0 against H1: elo = elo1 for the first player,
+ * with the false positive rate alpha and the false negative rate beta
+ *
+ * since NoGo has no draw, each game is a Bernoulli trial of the logistic score 1 / (1 + 10^(-elo / 400)),
+ * and the log-likelihood ratio is exact: LLR = W log(p1 / p0) + L log((1 - p1) / (1 - p0))
+ */
+class sprt {
+public:
+	sprt(double elo0 = 0, double elo1 = 10, double alpha = 0.05, double beta = 0.05)
+		: elo0(elo0), elo1(elo1), alpha(alpha), beta(beta), wins(0), losses(0) {}
+
+	void update(bool win) { (win ? wins : losses)++; }
+	size_t games() const { return wins + losses; }
+
+	double llr() const {
+		double p0 = score(elo0), p1 = score(elo1);
+		return wins * std::log(p1 / p0) + losses * std::log((1 - p1) / (1 - p0));
+	}
+	double lower() const { return std::log(beta / (1 - alpha)); }
+	double upper() const { return std::log((1 - beta) / alpha); }
+
+	/* 1 if H1 is accepted, -1 if H0 is accepted, or 0 if undecided yet */
+	int decision() const { return llr() >= upper() ? 1 : llr() <= lower() ? -1 : 0; }
+
+	/* the elo difference at z standard errors from the observed score, e.g., z = -1.96 and 1.96 for the 95% bounds */
+	double elo(double z = 0) const {
+		if (games() == 0) return 0;
+		double s = double(wins) / games(), se = std::sqrt(s * (1 - s) / games());
+		double x = std::min(std::max(s + z * se, 1e-6), 1 - 1e-6);
+		return -400 * std::log10(1 / x - 1);
+	}
+
+	static double score(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); }
+
+public:
+	double elo0, elo1, alpha, beta;
+	size_t wins, losses;
+};
+
+/**
+ * the match between the first and the second player configuration, which swaps the colors in each game pair,
+ * and plays the games in parallel until the SPRT is decided or the game count is reached
+ *
+ * options: elo0, elo1, alpha, beta (see sprt), and thread for the number of parallel games
+ */
+template<class board_type>
+class match {
+public:
+	match(const std::string& first, const std::string& second, const std::string& args = "")
+		: first(first), second(second), threads(1) {
+		std::map<std::string, std::string> meta = parse_options(args);
+		if (meta.count("elo0")) test.elo0 = std::stod(meta["elo0"]);
+		if (meta.count("elo1")) test.elo1 = std::stod(meta["elo1"]);
+		if (meta.count("alpha")) test.alpha = std::stod(meta["alpha"]);
+		if (meta.count("beta")) test.beta = std::stod(meta["beta"]);
+		if (meta.count("thread")) threads = std::max(std::stoi(meta["thread"]), 1);
+		if (test.elo0 >= test.elo1) throw std::invalid_argument("elo0 should be less than elo1");
+	}
+
+	/**
+	 * play at most total games, and report the result every block games (0 for every game pair) and at the end
+	 * return the SPRT decision of the first player, see sprt::decision
+	 */
+	int run(size_t total, size_t block = 0) {
+		std::atomic<size_t> next{0};
+		std::mutex mtx;
+		uint64_t seed = std::random_device()();
+		run_threads(threads, [&](int k) {
+			// the seeds are given first, so that a seed in the configuration still takes effect
+			auto meta = [&](const std::string& name, const std::string& args, const std::string& role, int n) {
+				return "seed=" + std::to_string(seed + k * 4 + n) + " name=" + name + " " + args + " role=" + role;
+			};
+			player<board_type> a_black(meta("first", first, "black", 0)), a_white(meta("first", first, "white", 1));
+			player<board_type> b_black(meta("second", second, "black", 2)), b_white(meta("second", second, "white", 3));
+			for (size_t g; (g = next++) < total; ) {
+				bool swap = g & 1; // the first player plays black in the even games
+				player<board_type>& black = swap ? b_black : a_black;
+				player<board_type>& white = swap ? a_white : b_white;
+				bool win = (play(black, white) == (swap ? board::white : board::black));
+				std::lock_guard<std::mutex> lock(mtx);
+				if (test.decision() || test.games() >= total) {
+					next = total; // the games finished after the decision are not counted
+					break;
+				}
+				test.update(win);
+				if (test.decision() || (block ? test.games() % block == 0 : test.games() % 2 == 0)) show();
+			}
+		});
+		if (test.games() % (block ? block : 2) != 0 && !test.decision()) show();
+		int result = test.decision();
+		std::cout << (result > 0 ? "H1 accepted" : result < 0 ? "H0 accepted" : "inconclusive")
+		          << " (elo0 = " << test.elo0 << ", elo1 = " << test.elo1
+		          << ", alpha = " << test.alpha << ", beta = " << test.beta << ")" << std::endl;
+		return result;
+	}
+
+	/* play a game from the initial state, and return the winner */
+	static board::piece_type play(player<board_type>& black, player<board_type>& white) {
+		episode<board_type> game;
+		black.open_episode("~:" + white.name());
+		white.open_episode(black.name() + ":~");
+		game.open_episode(black.name() + ":" + white.name());
+		while (true) {
+			agent<board_type>& who = game.take_turns(black, white);
+			action move = who.take_action(game.state());
+			if (game.apply_action(move) != true) break;
+			if (who.check_for_win(game.state())) break;
+		}
+		agent<board_type>& win = game.last_turns(black, white);
+		game.close_episode(win.name());
+		black.close_episode(win.name());
+		white.close_episode(win.name());
+		return (&win == &black) ? board::black : board::white;
+	}
+
+	const sprt& result() const { return test; }
+
+protected:
+	/**
+	 * show the result of the first player so far, e.g.,
+	 * 200	first 118 - 82 second, elo = 63.2 [14.3, 113.5], llr = 2.31 [-2.94, 2.94]
+	 * where the elo is bounded by the 95% confidence interval, and the llr by the SPRT bounds
+	 */
+	void show() const {
+		std::cout << test.games() << "\t"
+		          << "first " << test.wins << " - " << test.losses << " second, "
+		          << "elo = " << test.elo() << " [" << test.elo(-1.96) << ", " << test.elo(1.96) << "], "
+		          << "llr = " << test.llr() << " [" << test.lower() << ", " << test.upper() << "]" << std::endl;
+	}
+
+private:
+	std::string first, second;
+	int threads;
+	sprt test;
+};
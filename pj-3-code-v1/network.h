@@ -0,0 +1,210 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * network.h: A small convolutional policy/value network with int8 inference on CPU
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "board.h"
+#include "safety.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * the policy/value network of a few 3x3 convolutions with ReLU, followed by
+ *   the policy head: a 1x1 convolution into the logits of the points, with the softmax over the legal moves
+ *   the value head: the average pooling and a linear unit, with the sigmoid into the win probability
+ * both for the side to move; the input planes are the own stones, the opponent stones, the hollow points,
+ * the empty points, and the legal moves of both sides
+ *
+ * the convolutions run in int8: the weights are quantized per output channel when loaded, and the activations
+ * are quantized into [0, 127] by the ranges given in the file, so that the AVX2 kernels multiply the unsigned
+ * activations by the signed weights without saturation; the heads are small and run in float
+ *
+ * the weights are given as text: a line "nogo-net 6 <filters> <layers>", then for each convolution its range of
+ * the output activations, the weights in the order [output][input][dx + 1][dy + 1], and the biases of the outputs;
+ * then the weights and the bias of the policy head, and the ones of the value head
+ */
+template<class board_type>
+class policy_value_net {
+public:
+	enum { planes = 6, n = board_type::size_n };
+
+	bool empty() const { return layers.empty(); }
+
+	void load(const std::string& path) {
+		std::ifstream in(path);
+		if (!in.is_open()) throw std::invalid_argument("cannot open network file: " + path);
+		load(in);
+	}
+	void load(std::istream& in) {
+		std::string magic;
+		int inputs, filters, depth;
+		if (!(in >> magic >> inputs >> filters >> depth) || magic != "nogo-net" || inputs != planes || filters <= 0 || depth <= 0)
+			throw std::invalid_argument("invalid network header");
+		layers.clear();
+		for (int l = 0; l < depth; l++) {
+			layers.emplace_back();
+			conv& c = layers.back();
+			c.in = (l ? filters : planes), c.out = filters, c.stride = (c.in + 31) / 32 * 32;
+			std::vector<float> w(c.out * c.in * 9);
+			c.bias.resize(c.out);
+			if (!(in >> c.range) || !read(in, w) || !read(in, c.bias) || c.range <= 0)
+				throw std::invalid_argument("invalid network layer " + std::to_string(l));
+			c.weight.assign((c.out + 7) / 8 * 8 * 9 * c.stride, 0); // the outputs are padded for the kernel of eight
+			c.scale.resize(c.out);
+			for (int o = 0; o < c.out; o++) { // quantize symmetrically per output channel, into the layout [output][k][input]
+				float most = 0;
+				for (int i = 0; i < c.in * 9; i++) most = std::max(most, std::abs(w[o * c.in * 9 + i]));
+				c.scale[o] = (most > 0 ? most / 127 : 1);
+				for (int i = 0; i < c.in; i++)
+					for (int k = 0; k < 9; k++)
+						c.weight[(o * 9 + k) * c.stride + i] = int8_t(std::lround(w[(o * c.in + i) * 9 + k] / c.scale[o]));
+			}
+		}
+		policy_weight.resize(filters), value_weight.resize(filters);
+		if (!read(in, policy_weight) || !(in >> policy_bias) || !read(in, value_weight) || !(in >> value_bias))
+			throw std::invalid_argument("invalid network heads");
+	}
+
+	/**
+	 * evaluate the states for their sides to move, where value[k] is the win probability of the k-th state, and
+	 * policy[k * n + i] is the probability of the move at point i (0 for the illegal moves)
+	 */
+	void evaluate(const board_type* const states[], const board::piece_type tomove[], int count, float value[], float policy[]) const {
+		const table& near = neighbors();
+		int stride = std::max(layers.front().stride, (layers.back().out + 31) / 32 * 32);
+		std::vector<uint8_t> x(n * stride), y(n * stride);
+		std::vector<float> h(n);
+		for (int k = 0; k < count; k++) {
+			const board_type& b = *states[k];
+			unsigned who = tomove[k], opp = 3u - who;
+			safe_points<board_type> safety(b);
+			const typename safe_points<board_type>::points& legal = safety.legal_points(who);
+			std::fill(x.begin(), x.end(), 0);
+			for (int i = 0; i < n; i++) {
+				uint8_t* f = &x[i * layers.front().stride];
+				f[0] = (b(i) == who), f[1] = (b(i) == opp), f[2] = (b(i) == board::hollow), f[3] = (b(i) == board::empty);
+				f[4] = legal[i], f[5] = safety.legal_points(opp)[i];
+			}
+			float scale = 1; // of the input activations
+			for (const conv& c : layers) {
+				forward(c, near, x.data(), scale, y.data());
+				scale = c.range / 127;
+				std::swap(x, y);
+			}
+			const conv& last = layers.back();
+			float* p = policy + k * n;
+			float pooled = 0, most = -INFINITY;
+			for (int i = 0; i < n; i++) {
+				float logit = policy_bias;
+				const uint8_t* a = &x[i * last.stride];
+				for (int o = 0; o < last.out; o++) logit += policy_weight[o] * a[o] * scale;
+				for (int o = 0; o < last.out; o++) pooled += value_weight[o] * a[o] * scale;
+				h[i] = logit;
+				if (legal[i]) most = std::max(most, logit);
+			}
+			float sum = 0;
+			for (int i = 0; i < n; i++) sum += (p[i] = legal[i] ? std::exp(h[i] - most) : 0);
+			for (int i = 0; i < n && sum > 0; i++) p[i] /= sum;
+			// the side to move without any legal move loses
+			value[k] = legal.any() ? 1 / (1 + std::exp(-(pooled / n + value_bias))) : 0;
+		}
+	}
+
+protected:
+	struct conv {
+		int in, out, stride;        /* the input channels are padded to the stride, a multiple of 32 */
+		float range;                /* of the output activations, which are quantized into [0, 127] */
+		std::vector<int8_t> weight; /* [output][k][stride], where the outputs are padded to a multiple of 8 */
+		std::vector<float> scale, bias;
+	};
+	typedef std::vector<int> table; /* the point at the offset k of each point, or -1 if off the board */
+
+	static bool read(std::istream& in, std::vector<float>& v) {
+		for (float& x : v) if (!(in >> x)) return false;
+		return true;
+	}
+
+	static const table& neighbors() {
+		static const table near = []() {
+			table t(n * 9);
+			for (int i = 0; i < n; i++) {
+				typename board_type::point p(i);
+				for (int k = 0; k < 9; k++) {
+					int x = p.x + k / 3 - 1, y = p.y + k % 3 - 1;
+					t[i * 9 + k] = (x < 0 || x >= board_type::size_x || y < 0 || y >= board_type::size_y) ? -1 : x * board_type::size_y + y;
+				}
+			}
+			return t;
+		}();
+		return near;
+	}
+
+	/* the convolution of the quantized inputs (at the scale) into the quantized outputs */
+	static void forward(const conv& c, const table& near, const uint8_t* x, float scale, uint8_t* y) {
+		int out_stride = (c.out + 31) / 32 * 32;
+		for (int i = 0; i < n; i++) {
+			uint8_t* a = y + i * out_stride;
+			std::fill(a, a + out_stride, 0);
+			auto emit = [&](int o, int32_t acc) {
+				float v = std::max(acc * c.scale[o] * scale + c.bias[o], 0.0f);
+				a[o] = uint8_t(std::min(std::lround(v / c.range * 127), 127l));
+			};
+#if defined(__AVX2__)
+			// eight outputs at once, so that each input vector is loaded once for them
+			const __m256i ones = _mm256_set1_epi16(1);
+			for (int o = 0; o < c.out; o += 8) {
+				__m256i sum[8];
+				for (int m = 0; m < 8; m++) sum[m] = _mm256_setzero_si256();
+				for (int k = 0; k < 9; k++) {
+					int j = near[i * 9 + k];
+					if (j < 0) continue;
+					for (int s = 0; s < c.stride; s += 32) {
+						__m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + j * c.stride + s));
+						for (int m = 0; m < 8; m++) {
+							__m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&c.weight[((o + m) * 9 + k) * c.stride + s]));
+							sum[m] = _mm256_add_epi32(sum[m], _mm256_madd_epi16(_mm256_maddubs_epi16(u, w), ones));
+						}
+					}
+				}
+				__m256i lo = _mm256_hadd_epi32(_mm256_hadd_epi32(sum[0], sum[1]), _mm256_hadd_epi32(sum[2], sum[3]));
+				__m256i hi = _mm256_hadd_epi32(_mm256_hadd_epi32(sum[4], sum[5]), _mm256_hadd_epi32(sum[6], sum[7]));
+				int32_t acc[8];
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(acc),
+				                    _mm256_add_epi32(_mm256_permute2x128_si256(lo, hi, 0x20), _mm256_permute2x128_si256(lo, hi, 0x31)));
+				for (int m = 0; m < 8 && o + m < c.out; m++) emit(o + m, acc[m]);
+			}
+#else
+			for (int o = 0; o < c.out; o++) {
+				int32_t acc = 0;
+				for (int k = 0; k < 9; k++) {
+					int j = near[i * 9 + k];
+					if (j < 0) continue;
+					const uint8_t* u = x + j * c.stride;
+					const int8_t* w = &c.weight[(o * 9 + k) * c.stride];
+					for (int s = 0; s < c.in; s++) acc += int32_t(u[s]) * w[s];
+				}
+				emit(o, acc);
+			}
+#endif
+		}
+	}
+
+private:
+	std::vector<conv> layers;
+	std::vector<float> policy_weight, value_weight;
+	float policy_bias = 0, value_bias = 0;
+};
@@ -16,186 +16,368 @@
 #include "agent.h"
 #include "episode.h"
 #include "statistics.h"
+#include "gtp.h"
+#include "match.h"
+#include "tune.h"
+#include "selfplay.h"
+#include "analysis.h"
+#include "server.h"
+#include "check.h"
 
-int main(int argc, const char* argv[]) {
-	std::cout << "HollowNoGo-Demo: ";
-	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cout, " "));
-	std::cout << std::endl << std::endl;
-
+/**
+ * the command line options of the program
+ */
+struct options {
 	size_t total = 1000, block = 0, limit = 0;
 	std::string black_args, white_args;
 	std::string load_path, save_path;
 	std::string name = "TCG-HollowNoGo-Demo", version = "2022"; // for GTP shell
 	bool shell = false;
-	for (int i = 1; i < argc; i++) {
-		std::string arg = argv[i];
-		auto match_arg = [&](std::string flag) -> bool {
-			auto it = arg.find_first_not_of('-');
-			return arg.find(flag, it) == it;
-		};
-		auto next_opt = [&]() -> std::string {
-			auto it = arg.find('=') + 1;
-			return it ? arg.substr(it) : argv[++i];
-		};
-		if (match_arg("total")) {
-			total = std::stoull(next_opt());
-		} else if (match_arg("block")) {
-			block = std::stoull(next_opt());
-		} else if (match_arg("limit")) {
-			limit = std::stoull(next_opt());
-		} else if (match_arg("black")) {
-			black_args = next_opt();
-		} else if (match_arg("white")) {
-			white_args = next_opt();
-		} else if (match_arg("load")) {
-			load_path = next_opt();
-		} else if (match_arg("save")) {
-			save_path = next_opt();
-		} else if (match_arg("name")) {
-			name = next_opt();
-		} else if (match_arg("version")) {
-			version = next_opt();
-		} else if (match_arg("shell")) {
-			shell = true;
+	bool match = false; // play a match of black (the first) against white (the second) with SPRT
+	std::string match_args;
+	bool tune = false; // tune the parameters of black by self-play
+	std::string tune_args;
+	bool selfplay = false; // generate the training samples by the self-play of black
+	std::string selfplay_args;
+	bool analyze = false; // analyze the positions of the input by black, e.g., --analyze="positions.txt thread=8"
+	std::string analyze_args, output_path = "-";
+	bool server = false; // serve the GTP sessions over sockets, e.g., --server="127.0.0.1:10000 slot=8"
+	std::string server_args;
+	bool check = false; // validate the games of the files, e.g., --check="thread=8" games.sgf
+	std::string check_args;
+	bool worker = false; // search for the coordinator of a cluster, which is launched by option cluster of a player
+	std::string worker_args;
+	std::vector<std::string> files; // the arguments other than the options
+	unsigned board_size = 9; // 7, 9, or 11 for Hollow NoGo
+};
+
+/**
+ * the GTP shell of the players, which reads the commands from the reader and writes the responses to the output,
+ * until the input is closed or the command "quit"
+ */
+template<class board_type>
+void shell(const options& opt, command_reader& reader, std::ostream& out, statistics<board_type>& stats,
+           player<board_type>& black, player<board_type>& white) {
+	std::thread analysis; // the ongoing analysis, which is stopped by the next command
+	player<board_type>* last = nullptr; // the player of the last search, for "stop"
+	auto stop_analysis = [&]() {
+		if (!analysis.joinable()) return;
+		black.interrupt(), white.interrupt();
+		analysis.join();
+		reader.restore(); // unless the current command is also stopped
+		out << std::endl; // end of the analysis response
+	};
+
+	for (std::string command; reader.pop(command); ) {
+		std::vector<std::string> args;
+		std::istringstream iss(command);
+		for (std::string s; getline(iss, s, ' '); args.push_back(s));
+
+		stop_analysis();
+
+		std::string reply;
+		if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
+			if (!stats.is_episode_ongoing()) { // should open an episode
+				black.open_episode("~:" + white.name());
+				white.open_episode(black.name() + ":~");
+				stats.open_episode(black.name() + ":" + white.name());
+			}
+
+			episode<board_type>& game = stats.back();
+			agent<board_type>& who = game.take_turns(black, white);
+			if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
+				out << "= " << "resign" << std::endl << std::endl;
+				// show the error message and terminate the shell
+				std::cerr << "player color " << args[1] << " mismatch!" << std::endl;
+				std::cerr << "current state, "
+				          << who.role() << " to play: " << std::endl << game.state();
+				break;
+			}
+			if (args[0] == "play") { // play a move
+				std::string types = "?bw"; // black == 1, white == 2
+				action::place move(typename board_type::point(args[2]).i, types.find(who.role()[0]));
+				if (game.apply_action(move) != true) { // remote plays an illegal move?!
+					out << "= " << "resign" << std::endl << std::endl;
+					// show the error message and terminate the shell
+					std::cerr << who.role() << " plays an illegal action!" << std::endl;
+					std::cerr << "current state: " << std::endl << game.state();
+					int code = move.apply(game.state());
+					std::cerr << "action: " << args[1] << " " << args[2] << std::endl;
+					std::cerr << "reason: " << board::result_name(code) << std::endl;
+					break;
+				}
+			} else if (args[0] == "genmove") { // generate a move and play
+				action::place move = who.take_action(game.state());
+				last = (&who == &black) ? &black : &white;
+				if (game.apply_action(move) == true) {
+					reply = move.position<board_type>();
+				} else { // I have no legal move to play
+					reply = "resign";
+				}
+			}
+
+		} else if (args[0] == "clear_board" || args[0] == "quit") { // reset game, or quit
+			if (stats.is_episode_ongoing()) { // should close an opened episode
+				agent<board_type>& win = stats.back().last_turns(black, white);
+				stats.close_episode(win.name());
+				black.close_episode(win.name());
+				white.close_episode(win.name());
+			}
+			if (args[0] == "quit") break; // quit GTP shell
+
+		} else if (args[0] == "stop") { // the search before it is interrupted by the reader, report the best move so far
+			if (last && last->best_move().type() == action::place::type)
+				reply = action::place(last->best_move()).position<board_type>();
+
+		} else if (args[0] == "analyze") { // search the current state until the next command, e.g., analyze b 100
+			board_type state = stats.is_episode_ongoing() ? stats.back().state() : board_type();
+			player<board_type>& who = (state.info().who_take_turns == board::black) ? black : white;
+			unsigned interval = 100; // in centiseconds
+			for (size_t i = 1; i < args.size(); i++)
+				if (args[i].size() && std::isdigit(args[i][0])) interval = std::stoul(args[i]);
+			last = &who;
+			out << "= " << std::endl;
+			analysis = std::thread([&who, &out, state, interval]() {
+				who.analyze(state, [&out](const std::string& info) { out << info << std::endl; }, interval / 100.0);
+			});
+			continue;
+
+		} else if (args[0] == "save_tree" || args[0] == "load_tree" || args[0] == "merge_tree") { // e.g., save_tree game.tree
+			// save the tree of the last search, or load (merge) a tree for the player to move in the current state
+			board_type state = stats.is_episode_ongoing() ? stats.back().state() : board_type();
+			player<board_type>& who = (state.info().who_take_turns == board::black) ? black : white;
+			try {
+				if (args.size() < 2) throw std::invalid_argument("missing file name");
+				if (args[0] == "save_tree") (last ? *last : who).save_tree(args[1]);
+				else who.load_tree(args[1], args[0] == "merge_tree");
+			} catch (std::exception& e) {
+				out << "? " << e.what() << std::endl << std::endl;
+				continue;
+			}
+
+		} else if (args[0] == "probe") { // print the counters of the instrumented build, or "probe reset" to clear them
+			std::stringstream buf;
+			if (args.size() > 1 && args[1] == "reset") probe::reset();
+			else probe::dump(buf);
+			reply = probe::enabled ? "\n" + buf.str() : "not instrumented, see make probe";
+			if (reply.back() == '\n') reply.pop_back();
+
+		} else if (args[0] == "showboard") { // print the board
+			std::stringstream buf;
+			buf << (stats.is_episode_ongoing() ? stats.back().state() : board_type());
+			reply = "\n" + buf.str();
+			reply.pop_back(); // remove a new line
+
+		} else if (args[0] == "boardsize") { // set the board size
+			size_t size = std::stoul(args[1]);
+			if (size != board_type::size_x || size != board_type::size_y) {
+				std::cerr << "board size mismatch: " << args[1] << std::endl;
+			}
+			if (size > board_type::size_x || size > board_type::size_y) break;
+
+		} else if (args[0] == "name") { // report the name of the program
+			reply = opt.name;
+		} else if (args[0] == "version") { // report the version number of the program
+			reply = opt.version;
+		} else if (args[0] == "protocol_version") { // report GTP protocol version
+			reply = "2";
+		} else if (args[0] == "list_commands") { // print supported commands
+			reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
+			        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n"
+			        "stop\n" "analyze\n" "save_tree\n" "load_tree\n" "merge_tree\n" "probe";
+		} else {
+			reply = "unknown command";
+		}
+
+		out << "= " << reply << std::endl << std::endl;
+	}
+	stop_analysis();
+}
+
+/**
+ * launch the local games or the GTP shell on the given board geometry
+ */
+template<class board_type>
+int run(const options& opt) {
+	if (opt.match) { // launch the match between the configurations of black and white, which swap colors
+		match<board_type> test(opt.black_args, opt.white_args, opt.match_args);
+		test.run(opt.total, opt.block);
+		return 0;
+	}
+
+	if (opt.tune) { // launch the tuner of the configuration of black
+		spsa_tuner<board_type> tuner(opt.black_args, opt.tune_args);
+		tuner.run();
+		return 0;
+	}
+
+	if (opt.selfplay) { // launch the self-play of the configuration of black
+		self_play<board_type> games(opt.black_args, opt.selfplay_args);
+		return games.run() ? 0 : 1;
+	}
+
+	if (opt.analyze) { // launch the batch analysis of the positions by the configuration of black
+		std::stringstream args(opt.analyze_args);
+		std::string input, rest;
+		args >> input;
+		std::getline(args, rest);
+		std::ifstream file(input);
+		std::ofstream output;
+		if (input != "-" && !file.is_open()) {
+			std::cerr << "cannot open input: " << input << std::endl;
+			return 1;
 		}
+		if (opt.output_path != "-") output.open(opt.output_path, std::ios::out | std::ios::trunc);
+		batch_analysis<board_type> analysis(opt.black_args, rest);
+		analysis.run(input != "-" ? file : std::cin, opt.output_path != "-" ? output : std::cout);
+		return 0;
+	}
+
+	if (opt.check) { // launch the validator of the games of the files
+		game_checker<board_type> checker(opt.check_args);
+		return checker.run(opt.files.size() ? opt.files : std::vector<std::string>{"-"}, std::cout) ? 1 : 0;
+	}
+
+	if (opt.worker) { // serve the coordinator as a worker process of its cluster, see search_cluster
+		cluster_worker<board_type, player<board_type>> worker(opt.worker_args);
+		return worker.run();
+	}
+
+	if (opt.server) { // launch the GTP server, where each session is a shell of its own players
+		gtp_server server(opt.server_args);
+		std::cout << "listening on " << server.bound() << std::endl;
+		server.run([&](socket_stream& io) {
+			statistics<board_type> stats(opt.total, opt.block, opt.limit);
+			scheduled_player<board_type> black(server.scheduler(), "name=black " + opt.black_args + " role=black");
+			scheduled_player<board_type> white(server.scheduler(), "name=white " + opt.white_args + " role=white");
+			command_reader reader(io.in, [&](bool stop) { black.interrupt(stop), white.interrupt(stop); }, false);
+			shell<board_type>(opt, reader, io.out, stats, black, white); // until quit, or all commands are answered
+			io.hangup(); // the reader is joined after the connection is closed
+		});
+		return 0;
 	}
 
-	statistics stats(total, block, limit);
+	statistics<board_type> stats(opt.total, opt.block, opt.limit);
 
-	if (load_path.size()) {
-		std::ifstream in(load_path, std::ios::in);
+	if (opt.load_path.size()) {
+		std::ifstream in(opt.load_path, std::ios::in);
 		in >> stats;
 		in.close();
 		if (stats.is_finished()) stats.summary();
 	}
 
-	player black("name=black " + black_args + " role=black");
-	player white("name=white " + white_args + " role=white");
+	player<board_type> black("name=black " + opt.black_args + " role=black");
+	player<board_type> white("name=white " + opt.white_args + " role=white");
 
-	if (!shell) { // launch standard local games
+	if (!opt.shell) { // launch standard local games
 		while (!stats.is_finished()) {
 //			std::cerr << "======== Game " << stats.step() << " ========" << std::endl;
 			black.open_episode("~:" + white.name());
 			white.open_episode(black.name() + ":~");
 
 			stats.open_episode(black.name() + ":" + white.name());
-			episode& game = stats.back();
+			episode<board_type>& game = stats.back();
 			while (true) {
-				agent& who = game.take_turns(black, white);
+				agent<board_type>& who = game.take_turns(black, white);
 				action move = who.take_action(game.state());
 //				std::cerr << game.state() << "#" << game.step() << " " << who.name() << ": " << move << std::endl;
 				if (game.apply_action(move) != true) break;
 				if (who.check_for_win(game.state())) break;
 			}
-			agent& win = game.last_turns(black, white);
+			agent<board_type>& win = game.last_turns(black, white);
 			stats.close_episode(win.name());
 
 			black.close_episode(win.name());
 			white.close_episode(win.name());
 		}
 	} else { // launch GTP shell
-		for (std::string command; std::getline(std::cin, command); ) {
-			if (command.back() == '\r') command.pop_back();
-			if (command.empty()) continue;
-
-			std::vector<std::string> args;
-			std::istringstream iss(command);
-			for (std::string s; getline(iss, s, ' '); args.push_back(s));
-
-			std::string reply;
-			if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
-				if (!stats.is_episode_ongoing()) { // should open an episode
-					black.open_episode("~:" + white.name());
-					white.open_episode(black.name() + ":~");
-					stats.open_episode(black.name() + ":" + white.name());
-				}
-
-				episode& game = stats.back();
-				agent& who = game.take_turns(black, white);
-				if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
-					std::cout << "= " << "resign" << std::endl << std::endl;
-					// show the error message and terminate the shell
-					std::cerr << "player color " << args[1] << " mismatch!" << std::endl;
-					std::cerr << "current state, "
-					          << who.role() << " to play: " << std::endl << game.state();
-					break;
-				}
-				if (args[0] == "play") { // play a move
-					std::string types = "?bw"; // black == 1, white == 2
-					action::place move(args[2], types.find(who.role()[0]));
-					if (game.apply_action(move) != true) { // remote plays an illegal move?!
-						std::cout << "= " << "resign" << std::endl << std::endl;
-						// show the error message and terminate the shell
-						std::cerr << who.role() << " plays an illegal action!" << std::endl;
-						const char* reason[] = {
-							"legal",
-							"illegal_turn",
-							"illegal_pass",
-							"illegal_out_of_range",
-							"illegal_not_empty",
-							"illegal_suicide",
-							"illegal_take",
-							"unknown",
-						};
-						std::cerr << "current state: " << std::endl << game.state();
-						int code = move.apply(game.state());
-						std::cerr << "action: " << args[1] << " " << args[2] << std::endl;
-						std::cerr << "reason: " << reason[std::min(-code, 7)] << std::endl;
-						break;
-					}
-				} else if (args[0] == "genmove") { // generate a move and play
-					action::place move = who.take_action(game.state());
-					if (game.apply_action(move) == true) {
-						reply = move.position();
-					} else { // I have no legal move to play
-						reply = "resign";
-					}
-				}
-
-			} else if (args[0] == "clear_board" || args[0] == "quit") { // reset game, or quit
-				if (stats.is_episode_ongoing()) { // should close an opened episode
-					agent& win = stats.back().last_turns(black, white);
-					stats.close_episode(win.name());
-					black.close_episode(win.name());
-					white.close_episode(win.name());
-				}
-				if (args[0] == "quit") break; // quit GTP shell
-
-			} else if (args[0] == "showboard") { // print the board
-				std::stringstream buf;
-				buf << (stats.is_episode_ongoing() ? stats.back().state() : board());
-				reply = "\n" + buf.str();
-				reply.pop_back(); // remove a new line
-
-			} else if (args[0] == "boardsize") { // set the board size
-				size_t size = std::stoul(args[1]);
-				if (size != board::size_x || size != board::size_y) {
-					std::cerr << "board size mismatch: " << args[1] << std::endl;
-				}
-				if (size > board::size_x || size > board::size_y) break;
-
-			} else if (args[0] == "name") { // report the name of the program
-				reply = name;
-			} else if (args[0] == "version") { // report the version number of the program
-				reply = version;
-			} else if (args[0] == "protocol_version") { // report GTP protocol version
-				reply = "2";
-			} else if (args[0] == "list_commands") { // print supported commands
-				reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
-				        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n";
-			} else {
-				reply = "unknown command";
-			}
-
-			std::cout << "= " << reply << std::endl << std::endl;
-		}
+		// the commands are read in background, so that "stop" can interrupt an ongoing search, see command_reader
+		command_reader reader(std::cin, [&](bool stop) { black.interrupt(stop), white.interrupt(stop); });
+		shell(opt, reader, std::cout, stats, black, white);
 	}
 
-	if (save_path.size()) {
-		std::ofstream out(save_path, std::ios::out | std::ios::trunc);
+	if (opt.save_path.size()) {
+		std::ofstream out(opt.save_path, std::ios::out | std::ios::trunc);
 		out << stats;
 		out.close();
 	}
 
 	return 0;
 }
+
+int main(int argc, const char* argv[]) {
+	std::cout << "HollowNoGo-Demo: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cout, " "));
+	std::cout << std::endl << std::endl;
+
+	options opt;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (arg == "-" || arg[0] != '-') {
+			opt.files.push_back(arg);
+		} else if (match_arg("total")) {
+			opt.total = std::stoull(next_opt());
+		} else if (match_arg("block")) {
+			opt.block = std::stoull(next_opt());
+		} else if (match_arg("limit")) {
+			opt.limit = std::stoull(next_opt());
+		} else if (match_arg("black")) {
+			opt.black_args = next_opt();
+		} else if (match_arg("white")) {
+			opt.white_args = next_opt();
+		} else if (match_arg("load")) {
+			opt.load_path = next_opt();
+		} else if (match_arg("save")) {
+			opt.save_path = next_opt();
+		} else if (match_arg("name")) {
+			opt.name = next_opt();
+		} else if (match_arg("version")) {
+			opt.version = next_opt();
+		} else if (match_arg("shell")) {
+			opt.shell = true;
+		} else if (match_arg("match")) {
+			opt.match = true;
+			if (arg.find('=') != std::string::npos) opt.match_args = next_opt();
+		} else if (match_arg("tune")) {
+			opt.tune = true;
+			if (arg.find('=') != std::string::npos) opt.tune_args = next_opt();
+		} else if (match_arg("selfplay")) {
+			opt.selfplay = true;
+			if (arg.find('=') != std::string::npos) opt.selfplay_args = next_opt();
+		} else if (match_arg("analyze")) {
+			opt.analyze = true;
+			opt.analyze_args = next_opt();
+		} else if (match_arg("output")) {
+			opt.output_path = next_opt();
+		} else if (match_arg("server")) {
+			opt.server = true;
+			opt.server_args = next_opt();
+		} else if (match_arg("check")) {
+			opt.check = true;
+			if (arg.find('=') != std::string::npos) opt.check_args = next_opt();
+		} else if (match_arg("worker")) {
+			opt.worker = true;
+			opt.worker_args = next_opt();
+		} else if (match_arg("board")) {
+			opt.board_size = std::stoul(next_opt());
+		}
+	}
+
+	// pick the prebuilt board geometry
+	switch (opt.board_size) {
+	case 7:  return run<hollow_board<7>>(opt);
+	case 9:  return run<hollow_board<9>>(opt);
+	case 11: return run<hollow_board<11>>(opt);
+	default:
+		std::cerr << "unsupported board size: " << opt.board_size << std::endl;
+		return 1;
+	}
+}
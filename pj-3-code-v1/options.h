@@ -0,0 +1,31 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * options.h: The parser of the key=value options of the modes
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <map>
+#include <sstream>
+#include <iostream>
+
+/**
+ * read the rest of the stream as the options separated by spaces, e.g., "thread=8 output=tuned.conf",
+ * where a word without '=' is both the key and the value; the leading words which are not options
+ * (e.g., the address of --server) are read by the caller first
+ */
+inline std::map<std::string, std::string> parse_options(std::istream& in) {
+	std::map<std::string, std::string> meta;
+	for (std::string pair; in >> pair; )
+		meta[pair.substr(0, pair.find('='))] = pair.substr(pair.find('=') + 1);
+	return meta;
+}
+
+inline std::map<std::string, std::string> parse_options(const std::string& args) {
+	std::stringstream ss(args);
+	return parse_options(ss);
+}
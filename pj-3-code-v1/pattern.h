@@ -0,0 +1,221 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * pattern.h: 3x3 pattern weights and the pattern-guided random playouts
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "board.h"
+#include "safety.h"
+
+/**
+ * the move weights of the 3x3 patterns, for both sides to move
+ *
+ * a table is given as lines of "pattern weight", e.g., "?x?x.x?x? 0.0625", where the pattern lists the 3x3 points
+ * from the top row to the bottom row, and the center must be the empty point to play; the symbols are
+ *   '.' empty, 'X' the side to move, 'O' the opponent, '#' outside the board or hollow, '?' anything,
+ *   'x' either 'X' or '#', 'o' either 'O' or '#'
+ * a pattern also matches its rotations and reflections, and the later lines override the earlier ones;
+ * the patterns not listed have weight 1, and empty lines or lines starting with ';' are ignored
+ *
+ * the weights are stored as fixed-point numbers in the units of 1/256, and are clamped into [1/256, 256),
+ * so that every legal move remains possible
+ */
+class pattern_table {
+public:
+	typedef uint16_t weight;
+	enum { unit = 256 };
+
+	/* the built-in table, which only avoids filling the own eyes that the opponent can never use */
+	pattern_table() {
+		std::stringstream in("?x?x.x?x? 0.0625");
+		load(in);
+	}
+
+	weight operator ()(unsigned code, unsigned who) const { return table[(who - 1) << 16 | code]; }
+
+	void load(const std::string& path) {
+		std::ifstream in(path);
+		if (!in.is_open()) throw std::invalid_argument("cannot open pattern file: " + path);
+		load(in);
+	}
+	void load(std::istream& in) {
+		table.assign(2 << 16, unit);
+		for (std::string line; std::getline(in, line); ) {
+			std::stringstream ss(line);
+			std::string pattern;
+			double value;
+			if (!(ss >> pattern) || pattern[0] == ';') continue;
+			if (!(ss >> value)) throw std::invalid_argument("invalid pattern line: " + line);
+			assign(pattern, value);
+		}
+	}
+
+	/* assign the weight to the pattern and all its rotations and reflections */
+	void assign(const std::string& pattern, double value) {
+		if (pattern.size() != 9 || pattern[4] != '.' || pattern.find_first_not_of(".XO#?xo") != std::string::npos)
+			throw std::invalid_argument("invalid pattern: " + pattern);
+		weight w = weight(std::min(std::max(value * unit + 0.5, 1.0), 65535.0));
+		static const int dx[] = { -1, 1, 0, 0, -1, 1, -1, 1 }, dy[] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+		for (int s = 0; s < 8; s++) {
+			char slot[8];
+			for (int k = 0; k < 8; k++) { // transform the offset of the k-th surrounding point by the symmetry s
+				int x = (s & 1) ? dy[k] : dx[k], y = (s & 1) ? dx[k] : dy[k];
+				if (s & 2) x = -x;
+				if (s & 4) y = -y;
+				slot[k] = pattern[(1 - y) * 3 + (x + 1)];
+			}
+			expand(slot, 0, 0, w, board::black);
+			expand(slot, 0, 0, w, board::white);
+		}
+	}
+
+protected:
+	void expand(const char slot[], int k, unsigned code, weight w, unsigned who) {
+		if (k == 8) {
+			table[(who - 1) << 16 | code] = w;
+			return;
+		}
+		for (unsigned v = 0; v < 4; v++) {
+			if (match(slot[k], v, who)) expand(slot, k + 1, code | v << (2 * k), w, who);
+		}
+	}
+	static bool match(char symbol, unsigned v, unsigned who) {
+		switch (symbol) {
+		case '.': return v == board::empty;
+		case 'X': return v == who;
+		case 'O': return v == 3u - who;
+		case '#': return v == board::hollow;
+		case 'x': return v == who || v == board::hollow;
+		case 'o': return v == 3u - who || v == board::hollow;
+		default:  return true;
+		}
+	}
+
+private:
+	std::vector<weight> table; /* indexed by (who - 1) << 16 | code */
+};
+
+/**
+ * Fenwick tree of the integer weights of n items, for sampling an item proportional to its weight
+ * both updating a weight and sampling take O(log n)
+ */
+template<int n>
+class weight_tree {
+public:
+	weight_tree() : tree(), leaf(), sum(0) {}
+
+	uint32_t total() const { return sum; }
+	uint32_t get(int i) const { return leaf[i]; }
+	void set(int i, uint32_t w) {
+		uint32_t delta = w - leaf[i]; // wraps around for decreasing weights
+		leaf[i] = w;
+		sum += delta;
+		for (int x = i + 1; x <= n; x += x & -x) tree[x] += delta;
+	}
+
+	/* build from the weights of all items in O(n) */
+	void build(const uint32_t w[]) {
+		sum = 0;
+		for (int i = 0; i < n; i++) leaf[i] = tree[i + 1] = w[i], sum += w[i];
+		for (int x = 1; x <= n; x++) {
+			int up = x + (x & -x);
+			if (up <= n) tree[up] += tree[x];
+		}
+	}
+
+	/* find the item whose cumulative weight range covers r, where r < total() */
+	int find(uint32_t r) const {
+		int pos = 0;
+		for (int step = top(); step; step >>= 1) {
+			if (pos + step <= n && tree[pos + step] <= r) {
+				pos += step;
+				r -= tree[pos];
+			}
+		}
+		return pos;
+	}
+
+private:
+	static constexpr int top(int s = 1) { return s * 2 > n ? s : top(s * 2); }
+	std::array<uint32_t, n + 1> tree;
+	std::array<uint32_t, n> leaf;
+	uint32_t sum;
+};
+
+/**
+ * random playouts guided by the 3x3 pattern weights
+ *
+ * each side keeps the weights of the empty points in a weight_tree; after a move, only the moved point
+ * and its 8 surrounding points are updated, since the pattern codes of the others are not changed;
+ * a drawn point which turns out to be illegal is removed for good, since an illegal move remains illegal
+ * in NoGo (see safe_points)
+ */
+template<class board_type>
+class pattern_playout {
+public:
+	pattern_playout(const pattern_table& table) : table(table) {}
+
+	/**
+	 * play a game from the state until the side to move has no legal move, return the winner
+	 * with cutoff, the game stops early once the safe-point analysis decides the winner
+	 */
+	template<class random_engine>
+	board::piece_type run(board_type state, board::piece_type tomove, random_engine& engine, bool cutoff = false) const {
+		weight_tree<board_type::size_n> tree[2]; // for black and white
+		uint32_t w[2][board_type::size_n];
+		for (int i = 0; i < board_type::size_n; i++) {
+			bool empty = state(i) == board::empty;
+			w[0][i] = empty ? table(state.pattern(i), board::black) : 0;
+			w[1][i] = empty ? table(state.pattern(i), board::white) : 0;
+		}
+		tree[0].build(w[0]);
+		tree[1].build(w[1]);
+		state.info({ tomove });
+
+		safe_points<board_type> safety;
+		if (cutoff) safety.reset(state);
+
+		bool dead[2][board_type::size_n] = {}; // the points illegal for black and white
+		for (board::piece_type who = tomove; ; who = board::piece_type(3u - who)) {
+			board::piece_type decided = (cutoff ? safety.decided(who) : board::empty);
+			if (decided != board::empty) return decided;
+			weight_tree<board_type::size_n>& own = tree[who - 1];
+			int move = -1;
+			while (own.total()) {
+				int i = own.find(std::uniform_int_distribution<uint32_t>(0, own.total() - 1)(engine));
+				if (state.place(typename board_type::point(i), who) == board::legal) {
+					move = i;
+					break;
+				}
+				own.set(i, 0);
+				dead[who - 1][i] = true;
+			}
+			if (move == -1) return board::piece_type(3u - who); // no legal move, the opponent wins
+			if (cutoff) safety.update(state, move);
+
+			tree[0].set(move, 0);
+			tree[1].set(move, 0);
+			for (int k = 0; k < 8; k++) {
+				int j = board_type::around(move, k);
+				if (j == move || state(j) != board::empty) continue;
+				if (!dead[0][j]) tree[0].set(j, table(state.pattern(j), board::black));
+				if (!dead[1][j]) tree[1].set(j, table(state.pattern(j), board::white));
+			}
+		}
+	}
+
+private:
+	const pattern_table& table;
+};
@@ -0,0 +1,262 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * playout.h: Batched random playouts, advancing several games in lockstep on bitboards
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "board.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * four lanes of 128-bit bitboards, where each lane belongs to an independent playout
+ * bit (i) of a lane is the point (i) of the board, i.e., points 0 ~ 63 are in lo, and points 64 ~ 127 are in hi
+ *
+ * the lanes are held in two AVX2 registers if available, or in plain arrays otherwise
+ * masks of lanes are given as 4-bit integers, where bit k stands for the k-th lane
+ */
+#if defined(__AVX2__)
+struct lanes {
+	__m256i lo, hi;
+
+	static lanes fill(uint64_t l, uint64_t h) { return { _mm256_set1_epi64x(l), _mm256_set1_epi64x(h) }; }
+	static lanes mask(unsigned m) {
+		__m256i v = _mm256_set_epi64x(-uint64_t(m >> 3 & 1), -uint64_t(m >> 2 & 1), -uint64_t(m >> 1 & 1), -uint64_t(m & 1));
+		return { v, v };
+	}
+	static lanes load(const uint64_t* l, const uint64_t* h) {
+		return { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(l)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h)) };
+	}
+	void store(uint64_t* l, uint64_t* h) const {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(l), lo);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(h), hi);
+	}
+
+	lanes operator &(const lanes& b) const { return { _mm256_and_si256(lo, b.lo), _mm256_and_si256(hi, b.hi) }; }
+	lanes operator |(const lanes& b) const { return { _mm256_or_si256(lo, b.lo), _mm256_or_si256(hi, b.hi) }; }
+	lanes operator ^(const lanes& b) const { return { _mm256_xor_si256(lo, b.lo), _mm256_xor_si256(hi, b.hi) }; }
+	lanes andnot(const lanes& b) const { return { _mm256_andnot_si256(lo, b.lo), _mm256_andnot_si256(hi, b.hi) }; } // ~this & b
+	bool operator ==(const lanes& b) const {
+		__m256i x = _mm256_or_si256(_mm256_xor_si256(lo, b.lo), _mm256_xor_si256(hi, b.hi));
+		return _mm256_testz_si256(x, x);
+	}
+	bool operator !=(const lanes& b) const { return !(*this == b); }
+
+	template<int s> lanes shl() const { // bit (i) to bit (i + s)
+		return { _mm256_slli_epi64(lo, s), _mm256_or_si256(_mm256_slli_epi64(hi, s), _mm256_srli_epi64(lo, 64 - s)) };
+	}
+	template<int s> lanes shr() const { // bit (i) to bit (i - s)
+		return { _mm256_or_si256(_mm256_srli_epi64(lo, s), _mm256_slli_epi64(hi, 64 - s)), _mm256_srli_epi64(hi, s) };
+	}
+	unsigned any() const { // the mask of nonzero lanes
+		__m256i z = _mm256_cmpeq_epi64(_mm256_or_si256(lo, hi), _mm256_setzero_si256());
+		return ~_mm256_movemask_pd(_mm256_castsi256_pd(z)) & 0xfu;
+	}
+};
+#else
+struct lanes {
+	uint64_t lo[4], hi[4];
+
+	static lanes fill(uint64_t l, uint64_t h) { return { { l, l, l, l }, { h, h, h, h } }; }
+	static lanes mask(unsigned m) {
+		lanes r;
+		for (int k = 0; k < 4; k++) r.lo[k] = r.hi[k] = -uint64_t(m >> k & 1);
+		return r;
+	}
+	static lanes load(const uint64_t* l, const uint64_t* h) {
+		lanes r;
+		std::copy(l, l + 4, r.lo);
+		std::copy(h, h + 4, r.hi);
+		return r;
+	}
+	void store(uint64_t* l, uint64_t* h) const {
+		std::copy(lo, lo + 4, l);
+		std::copy(hi, hi + 4, h);
+	}
+
+	template<typename op> lanes apply(const lanes& b, op f) const {
+		lanes r;
+		for (int k = 0; k < 4; k++) r.lo[k] = f(lo[k], b.lo[k]), r.hi[k] = f(hi[k], b.hi[k]);
+		return r;
+	}
+	lanes operator &(const lanes& b) const { return apply(b, [](uint64_t x, uint64_t y) { return x & y; }); }
+	lanes operator |(const lanes& b) const { return apply(b, [](uint64_t x, uint64_t y) { return x | y; }); }
+	lanes operator ^(const lanes& b) const { return apply(b, [](uint64_t x, uint64_t y) { return x ^ y; }); }
+	lanes andnot(const lanes& b) const { return apply(b, [](uint64_t x, uint64_t y) { return ~x & y; }); } // ~this & b
+	bool operator ==(const lanes& b) const {
+		return std::equal(lo, lo + 4, b.lo) && std::equal(hi, hi + 4, b.hi);
+	}
+	bool operator !=(const lanes& b) const { return !(*this == b); }
+
+	template<int s> lanes shl() const { // bit (i) to bit (i + s)
+		lanes r;
+		for (int k = 0; k < 4; k++) r.lo[k] = lo[k] << s, r.hi[k] = (hi[k] << s) | (lo[k] >> (64 - s));
+		return r;
+	}
+	template<int s> lanes shr() const { // bit (i) to bit (i - s)
+		lanes r;
+		for (int k = 0; k < 4; k++) r.lo[k] = (lo[k] >> s) | (hi[k] << (64 - s)), r.hi[k] = hi[k] >> s;
+		return r;
+	}
+	unsigned any() const { // the mask of nonzero lanes
+		unsigned m = 0;
+		for (int k = 0; k < 4; k++) m |= ((lo[k] | hi[k]) != 0) << k;
+		return m;
+	}
+};
+#endif
+
+/**
+ * batched random playouts for boards of at most 128 points
+ *
+ * four playouts are advanced in lockstep: at each step, every unfinished lane draws a random untried empty point,
+ * and the legality of the drawn points is verified for all lanes at once by flood-filling the affected blocks;
+ * a lane whose empty points are all illegal is terminal, and is masked out until the others are finished
+ *
+ * since the moves are drawn uniformly from the untried points until a legal one is found,
+ * the distribution of moves is the same as the uniformly random scalar playout
+ */
+template<class board_type>
+class batch_playout {
+	static_assert(board_type::size_n <= 128, "the board is too large for 128-bit bitboards");
+public:
+	enum { width = 4, step = board_type::size_y };
+
+	batch_playout() {
+		uint64_t play[2] = {}, top[2] = {}, bottom[2] = {};
+		for (int i = 0; i < board_type::size_n; i++) {
+			typename board_type::point p(i);
+			if (!board_type::is_hollow(i)) play[i / 64] |= 1ull << (i % 64);
+			if (p.y == board_type::size_y - 1) top[i / 64] |= 1ull << (i % 64);
+			if (p.y == 0) bottom[i / 64] |= 1ull << (i % 64);
+		}
+		playable = lanes::fill(play[0], play[1]);
+		not_top = lanes::fill(~top[0], ~top[1]);
+		not_bottom = lanes::fill(~bottom[0], ~bottom[1]);
+	}
+
+public:
+	/**
+	 * play random games from the given states until the side to move has no legal move
+	 * tomove[k] is the side to move of states[k], and the winner of the k-th game is stored in winner[k]
+	 */
+	template<class random_engine>
+	void run(const board_type* const states[], const board::piece_type tomove[], board::piece_type winner[],
+			size_t n, random_engine& engine) const {
+		for (size_t base = 0; base < n; base += width) {
+			size_t num = std::min<size_t>(width, n - base);
+			run_lanes(states + base, tomove + base, winner + base, num, engine);
+		}
+	}
+
+protected:
+	template<class random_engine>
+	void run_lanes(const board_type* const states[], const board::piece_type tomove[], board::piece_type winner[],
+			size_t num, random_engine& engine) const {
+		uint64_t b_lo[width] = {}, b_hi[width] = {}, w_lo[width] = {}, w_hi[width] = {};
+		unsigned active = 0, black_turn = 0;
+		for (size_t k = 0; k < num; k++) {
+			for (int i = 0; i < board_type::size_n; i++) {
+				board::cell c = (*states[k])(i);
+				if (c == board::black) (i < 64 ? b_lo[k] : b_hi[k]) |= 1ull << (i % 64);
+				if (c == board::white) (i < 64 ? w_lo[k] : w_hi[k]) |= 1ull << (i % 64);
+			}
+			active |= 1u << k;
+			if (tomove[k] == board::black) black_turn |= 1u << k;
+		}
+		lanes black = lanes::load(b_lo, b_hi), white = lanes::load(w_lo, w_hi);
+
+		while (active) {
+			lanes turn = lanes::mask(black_turn);
+			lanes own = (turn & black) | turn.andnot(white);
+			lanes opp = (turn & white) | turn.andnot(black);
+			lanes empty = (black | white).andnot(playable);
+
+			uint64_t untried_lo[width], untried_hi[width], move_lo[width], move_hi[width];
+			empty.store(untried_lo, untried_hi);
+			lanes chosen = lanes::fill(0, 0);
+			for (unsigned pending = active; pending; ) {
+				for (unsigned k = 0; k < width; k++) {
+					move_lo[k] = move_hi[k] = 0;
+					if (!(pending & (1u << k))) continue;
+					int count = __builtin_popcountll(untried_lo[k]) + __builtin_popcountll(untried_hi[k]);
+					if (count == 0) { // no legal move, the opponent wins
+						winner[k] = (black_turn & (1u << k)) ? board::white : board::black;
+						pending &= ~(1u << k);
+						active &= ~(1u << k);
+						continue;
+					}
+					int pick = std::uniform_int_distribution<int>(0, count - 1)(engine);
+					int count_lo = __builtin_popcountll(untried_lo[k]);
+					if (pick < count_lo) {
+						move_lo[k] = select(untried_lo[k], pick);
+						untried_lo[k] &= ~move_lo[k];
+					} else {
+						move_hi[k] = select(untried_hi[k], pick - count_lo);
+						untried_hi[k] &= ~move_hi[k];
+					}
+				}
+				if (!pending) break;
+				lanes move = lanes::load(move_lo, move_hi);
+				unsigned legal = check(move, own, opp, empty) & pending;
+				chosen = chosen | (move & lanes::mask(legal));
+				pending &= ~legal;
+			}
+
+			black = black | (turn & chosen);
+			white = white | turn.andnot(chosen);
+			black_turn ^= active;
+		}
+	}
+
+	/**
+	 * check the legality of the moves of all lanes, return the mask of legal lanes
+	 * a move is legal if the block containing it and all the adjacent opponent blocks still have liberties
+	 */
+	unsigned check(const lanes& move, const lanes& own, const lanes& opp, const lanes& empty) const {
+		lanes space = move.andnot(empty);
+		lanes near = dilate(move);
+		unsigned legal = (near & space).any() & ~(near & opp).any();
+		if (((legal | ~move.any()) & 0xfu) == 0xfu) return legal; // all are trivially legal
+
+		legal = (dilate(flood(move, own | move)) & space).any();
+		lanes side[4] = { move.template shr<step>(), move.template shl<step>(),
+		                  move.template shr<1>() & not_top, move.template shl<1>() & not_bottom };
+		for (const lanes& adj : side) {
+			lanes seed = adj & opp;
+			unsigned exist = seed.any();
+			if (exist) legal &= ~exist | (dilate(flood(seed, opp)) & space).any();
+		}
+		return legal;
+	}
+
+	lanes dilate(const lanes& x) const {
+		lanes r = x | x.template shr<step>() | x.template shl<step>();
+		r = r | (x.template shr<1>() & not_top) | (x.template shl<1>() & not_bottom);
+		return r & playable;
+	}
+	lanes flood(lanes seed, const lanes& within) const {
+		for (lanes next = dilate(seed) & within; next != seed; next = dilate(seed) & within) seed = next;
+		return seed;
+	}
+
+	static uint64_t select(uint64_t x, int k) { // the k-th set bit of x
+#if defined(__BMI2__)
+		return _pdep_u64(1ull << k, x);
+#else
+		for (; k; k--) x &= x - 1;
+		return x & -x;
+#endif
+	}
+
+private:
+	lanes playable, not_top, not_bottom;
+};
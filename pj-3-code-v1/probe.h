@@ -0,0 +1,162 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * probe.h: The compile-time instrumentation of the board and the search
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include <iomanip>
+
+/**
+ * the build flag of the instrumentation, e.g., make probe (or -DNOGO_PROBE), which is off by default;
+ * when off, the counters and the timers are empty inline functions, and are compiled out entirely
+ */
+#ifndef NOGO_PROBE
+#define NOGO_PROBE 0
+#endif
+
+namespace probe {
+
+/* the counted events */
+enum event {
+	legality,         /* the legality checks by board::place */
+	flood_step,       /* the points visited by the flood fills of the liberties */
+	rollout,          /* the scalar playouts of MCTS */
+	rollout_move,     /* the moves of the scalar playouts */
+	expansion,        /* the expansions of MCTS */
+	expansion_child,  /* the children created by the expansions */
+	selection,        /* the selections of MCTS */
+	selection_depth,  /* the depth of the selections */
+	backpropagation,  /* the backpropagations of MCTS */
+	events
+};
+
+/* the timed sections */
+enum section {
+	in_place,           /* board::place */
+	in_liberty,         /* board::check_liberty */
+	in_simulation,      /* player::simulation */
+	in_selection,       /* player::selection */
+	in_backpropagation, /* player::backpropagation */
+	sections
+};
+
+template<bool enabled> class recorder;
+
+/**
+ * the recorder of the default build, which does nothing
+ */
+template<> class recorder<false> {
+public:
+	static void count(event, uint64_t = 1) {}
+	struct scope { scope(section) {} };
+	static void dump(std::ostream&) {}
+	static void reset() {}
+};
+
+/**
+ * the recorder of the instrumented build, where each thread counts in its own block of cache lines,
+ * so the threads never share a line; the blocks are kept after the threads exit, and are summed when dumped
+ */
+template<> class recorder<true> {
+public:
+	static void count(event e, uint64_t n = 1) { bump(local().events[e], n); }
+
+	/* time the section in the scope */
+	class scope {
+	public:
+		scope(section s) : s(s), start(std::chrono::steady_clock::now()) {}
+		~scope() {
+			block& b = local();
+			bump(b.calls[s], 1);
+			bump(b.nanos[s], std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+	private:
+		section s;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	/**
+	 * print the sums of all threads, e.g.,
+	 * probe	legality = 1234567, flood_step = 4567890, ...
+	 * probe	place: calls = 1234567, time = 0.123 s (99.6 ns/call)
+	 */
+	static void dump(std::ostream& out) {
+		uint64_t events[probe::events] = {}, calls[probe::sections] = {}, nanos[probe::sections] = {};
+		{
+			std::lock_guard<std::mutex> lock(registry().mtx);
+			for (block* b : registry().blocks) {
+				for (int e = 0; e < probe::events; e++) events[e] += b->events[e].load(std::memory_order_relaxed);
+				for (int s = 0; s < probe::sections; s++) calls[s] += b->calls[s].load(std::memory_order_relaxed);
+				for (int s = 0; s < probe::sections; s++) nanos[s] += b->nanos[s].load(std::memory_order_relaxed);
+			}
+		}
+		static const char* event_names[] = { "legality", "flood_step", "rollout", "rollout_move", "expansion",
+		                                     "expansion_child", "selection", "selection_depth", "backpropagation" };
+		static const char* section_names[] = { "place", "check_liberty", "simulation", "selection", "backpropagation" };
+		out << "probe\t";
+		for (int e = 0; e < probe::events; e++) out << (e ? ", " : "") << event_names[e] << " = " << events[e];
+		out << std::endl;
+		for (int s = 0; s < probe::sections; s++) {
+			if (calls[s] == 0) continue;
+			out << "probe\t" << section_names[s] << ": calls = " << calls[s] << ", time = "
+			    << std::fixed << std::setprecision(3) << nanos[s] * 1e-9 << " s (" << std::setprecision(1)
+			    << double(nanos[s]) / calls[s] << " ns/call)" << std::defaultfloat << std::endl;
+		}
+	}
+
+	/* clear the counters, which is approximate if the threads are still counting */
+	static void reset() {
+		std::lock_guard<std::mutex> lock(registry().mtx);
+		for (block* b : registry().blocks) {
+			for (auto& x : b->events) x.store(0, std::memory_order_relaxed);
+			for (auto& x : b->calls) x.store(0, std::memory_order_relaxed);
+			for (auto& x : b->nanos) x.store(0, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	struct alignas(64) block {
+		std::atomic<uint64_t> events[probe::events], calls[probe::sections], nanos[probe::sections];
+	};
+	struct blocks {
+		std::mutex mtx;
+		std::vector<block*> blocks;
+	};
+
+	/* only the owner thread writes, so a relaxed load and store is enough, without a locked instruction */
+	static void bump(std::atomic<uint64_t>& x, uint64_t n) { x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+	static blocks& registry() { static blocks r; return r; }
+	static block& local() {
+		static thread_local block* mine = nullptr;
+		if (mine) return *mine;
+		void* p = nullptr; // aligned by hand, since the operator new of C++ 11 ignores the over-alignment
+		if (posix_memalign(&p, alignof(block), sizeof(block)) != 0) throw std::bad_alloc();
+		mine = new (p) block();
+		std::lock_guard<std::mutex> lock(registry().mtx);
+		registry().blocks.push_back(mine);
+		return *mine;
+	}
+};
+
+typedef recorder<NOGO_PROBE != 0> active;
+constexpr bool enabled = (NOGO_PROBE != 0);
+
+inline void count(event e, uint64_t n = 1) { active::count(e, n); }
+typedef active::scope scope;
+inline void dump(std::ostream& out) { active::dump(out); }
+inline void reset() { active::reset(); }
+
+} // namespace probe
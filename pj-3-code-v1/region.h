@@ -0,0 +1,223 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * region.h: Decompose the board into independent regions, and bound the moves of each region
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <bitset>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <unordered_map>
+#include "board.h"
+#include "safety.h"
+
+/**
+ * the region decomposition of NoGo
+ *
+ * the legality of a move only depends on its neighbors and the liberties of the adjacent blocks, hence
+ * the empty points linked by adjacency or by sharing an adjacent block form a region, and the play in one
+ * region never affects the others; the region, together with the stones of its adjacent blocks,
+ * is identified by the Zobrist hash of its points
+ *
+ * for each side, a region of few empty points is solved for
+ *   upper: the most moves the side can make in the region, which is reached if the opponent never plays there,
+ *          since any stone only removes liberties and never makes an illegal move legal
+ *   lower: the moves the side can make in the region in any case, i.e., the minimax value of the game where
+ *          the opponent may play there any number of times before each move of the side
+ * larger regions, and the regions whose search exceeds the node budget, fall back to the bounds of the safe-point
+ * analysis; the bounds of the regions are cached by the region hash, and are summed up to decide the whole board
+ * in the same way as safe_points::decided
+ *
+ * the exact search grows exponentially with the region size, so the limit is clamped to max_limit (16), and the
+ * searches are bounded by the budget of positions per region (2000 by default), and by the allowance of positions
+ * until the next refill (50 times the budget, refilled by the player for each move); a region which exceeds
+ * the budget is cached with the safe-point bounds, while the one which runs out of the allowance is solved later
+ */
+template<class board_type>
+class region_solver {
+public:
+	typedef std::bitset<board_type::size_n> points;
+	struct bounds {
+		int lower[2], upper[2]; // for black and white
+	};
+	struct region {
+		points empty, closure; // the empty points, and also the stones of the adjacent blocks
+		uint64_t hash;
+	};
+
+	static constexpr int max_limit = 16;
+
+	/* the regions of at most limit empty points are solved exactly, 0 for the safe-point bounds only */
+	region_solver(int limit = 8, size_t budget = 2000) : limit(clamp(limit)), budget(budget), allowance(std::numeric_limits<int64_t>::max() / 2) {}
+
+	void set_limit(int n) { limit = clamp(n); }
+	int get_limit() const { return limit; }
+	void set_budget(size_t n) { budget = std::max<size_t>(n, 1); }
+
+	/* reset the allowance of the exact searches, e.g., for each move */
+	void refill() { allowance = int64_t(budget) * 50; }
+
+	/* split the empty points into independent regions */
+	std::vector<region> split(const board_type& b) const {
+		int16_t link[board_type::size_n];
+		for (int i = 0; i < board_type::size_n; i++) link[i] = i;
+		auto root = [&](int i) {
+			while (link[i] != i) i = link[i] = link[link[i]];
+			return i;
+		};
+		for (int i = 0; i < board_type::size_n; i++) {
+			if (b(i) == board::hollow) continue;
+			for (int d = 1; d < 4; d += 2) { // right and up, the others are linked from the other side
+				int j = board_type::neighbor(i, d);
+				if (j == i) continue;
+				if (b(i) == board::empty || b(j) == board::empty || b(i) == b(j)) link[root(j)] = root(i);
+			}
+		}
+		std::vector<region> regions;
+		int16_t index[board_type::size_n];
+		std::fill(index, index + board_type::size_n, -1);
+		for (int i = 0; i < board_type::size_n; i++) {
+			if (b(i) != board::empty) continue;
+			int r = root(i);
+			if (index[r] == -1) index[r] = regions.size(), regions.push_back({ {}, {}, 0 });
+			regions[index[r]].empty.set(i);
+		}
+		for (int i = 0; i < board_type::size_n; i++) {
+			if (b(i) == board::hollow || index[root(i)] == -1) continue;
+			region& r = regions[index[root(i)]];
+			r.closure.set(i);
+			r.hash ^= zobrist(i, b(i));
+		}
+		return regions;
+	}
+
+	/* the bounds of a region, which are solved or taken from the cache */
+	bounds solve(const board_type& b, const region& r, const safe_points<board_type>& safety) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			auto it = cache.find(r.hash);
+			if (it != cache.end()) return it->second;
+		}
+		bounds x;
+		bool cached = true;
+		for (unsigned who = board::black; who <= board::white; who++) {
+			bool exact = int(r.empty.count()) <= limit;
+			if (exact) {
+				int64_t grant = std::min<int64_t>(budget, std::max<int64_t>(allowance.fetch_sub(budget), 0));
+				search s(grant);
+				x.upper[who - 1] = most(b, r.empty, r.hash, who, s);
+				s.memo.clear();
+				x.lower[who - 1] = least(b, r.empty, r.hash, who, s);
+				exact = (s.nodes <= s.budget);
+				allowance += budget - std::min<size_t>(s.nodes, grant); // give back the unused positions
+				if (!exact && s.budget < budget) cached = false; // out of the allowance rather than the budget
+			}
+			if (!exact) {
+				x.upper[who - 1] = safety.moves(who, r.empty);
+				x.lower[who - 1] = safety.guaranteed(who, r.empty);
+			}
+		}
+		if (!cached) return x;
+		std::lock_guard<std::mutex> lock(mtx);
+		if (cache.size() >= capacity) cache.clear();
+		cache[r.hash] = x;
+		return x;
+	}
+
+	/**
+	 * decide the winner by the sum of the bounds of all regions when who is to move,
+	 * or return board::empty if undecided
+	 */
+	board::piece_type decided(const board_type& b, unsigned who) {
+		safe_points<board_type> safety(b);
+		int lower[2] = {}, upper[2] = {};
+		for (const region& r : split(b)) {
+			bounds x = solve(b, r, safety);
+			for (int c = 0; c < 2; c++) lower[c] += x.lower[c], upper[c] += x.upper[c];
+		}
+		unsigned opp = 3u - who;
+		if (lower[who - 1] > upper[opp - 1]) return board::piece_type(who);
+		if (lower[opp - 1] >= upper[who - 1]) return board::piece_type(opp);
+		return board::empty;
+	}
+
+	/* a move of who which keeps the win decided, or -1 if the win is not decided */
+	int winning_move(const board_type& b, unsigned who) {
+		if (decided(b, who) != who) return -1;
+		for (int i = 0; i < board_type::size_n; i++) {
+			board_type after = b;
+			if (play(after, i, who) && decided(after, 3u - who) == who) return i;
+		}
+		return -1;
+	}
+
+protected:
+	/* the memo of an exact search, which is abandoned once it visits more positions than the budget */
+	struct search {
+		search(size_t budget) : nodes(0), budget(budget) {}
+		std::unordered_map<uint64_t, int> memo;
+		size_t nodes, budget;
+		bool exceeded() { return ++nodes > budget; }
+	};
+
+	static int clamp(int n) { return std::min(std::max(n, 0), max_limit); }
+
+	static bool play(board_type& b, int i, unsigned who) {
+		b.info({ board::piece_type(who) });
+		return b.place(typename board_type::point(i), who) == board::legal;
+	}
+
+	/* the most moves that who can make in the region alone */
+	int most(const board_type& b, const points& empty, uint64_t hash, unsigned who, search& s) {
+		auto it = s.memo.find(hash);
+		if (it != s.memo.end()) return it->second;
+		if (s.exceeded()) return 0;
+		int best = 0;
+		for (int i = empty._Find_first(); i < board_type::size_n; i = empty._Find_next(i)) {
+			board_type after = b;
+			if (!play(after, i, who)) continue;
+			points rest = empty;
+			rest.reset(i);
+			best = std::max(best, 1 + most(after, rest, hash ^ zobrist(i, board::empty) ^ zobrist(i, who), who, s));
+		}
+		return s.memo[hash] = best;
+	}
+
+	/* the moves that who can make in the region, even if the opponent plays first as many times as it likes */
+	int least(const board_type& b, const points& empty, uint64_t hash, unsigned who, search& s) {
+		auto it = s.memo.find(hash);
+		if (it != s.memo.end()) return it->second;
+		if (s.exceeded()) return 0;
+		int own = 0, worst = board_type::size_n;
+		for (int i = empty._Find_first(); i < board_type::size_n; i = empty._Find_next(i)) {
+			points rest = empty;
+			rest.reset(i);
+			board_type after = b;
+			if (play(after, i, who)) // let who move now
+				own = std::max(own, 1 + least(after, rest, hash ^ zobrist(i, board::empty) ^ zobrist(i, who), who, s));
+			after = b;
+			if (play(after, i, 3u - who)) // or let the opponent interfere first
+				worst = std::min(worst, least(after, rest, hash ^ zobrist(i, board::empty) ^ zobrist(i, 3u - who), who, s));
+		}
+		return s.memo[hash] = std::min(own, worst);
+	}
+
+	static uint64_t zobrist(int i, unsigned cell) { return board_type::zobrist(i, cell); }
+
+private:
+	int limit;
+	size_t budget;
+	std::atomic<int64_t> allowance;
+	static constexpr size_t capacity = 1 << 20;
+	std::unordered_map<uint64_t, bounds> cache;
+	std::mutex mtx;
+};
+
+template<class board_type> constexpr size_t region_solver<board_type>::capacity;
+template<class board_type> constexpr int region_solver<board_type>::max_limit;
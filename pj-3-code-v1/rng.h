@@ -0,0 +1,77 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * rng.h: The fast random number generator with independent streams
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cstdint>
+#include <limits>
+
+/**
+ * xoshiro256** (Blackman and Vigna 2018), seeded by splitmix64
+ *
+ * it is a UniformRandomBitGenerator, so that it also works with the standard distributions;
+ * the k-th stream of a seed starts 2^128 * k draws later than the stream 0, so that the streams never overlap,
+ * e.g., one stream per search thread derived from the seed of the agent
+ */
+class xoshiro256 {
+public:
+	typedef uint64_t result_type;
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+	xoshiro256(uint64_t seed = 0, unsigned stream = 0) { this->seed(seed, stream); }
+
+	void seed(uint64_t seed, unsigned stream = 0) {
+		for (uint64_t& x : s) { // splitmix64
+			uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			x = z ^ (z >> 31);
+		}
+		for (unsigned k = 0; k < stream; k++) jump();
+	}
+
+	result_type operator ()() {
+		uint64_t result = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	/* an unbiased integer in [0, n) for n > 0, by the multiply-and-reject method (Lemire 2019) */
+	uint32_t bounded(uint32_t n) {
+		uint64_t m = uint64_t(uint32_t(operator ()() >> 32)) * n;
+		if (uint32_t(m) < n) {
+			uint32_t threshold = uint32_t(-n) % n;
+			while (uint32_t(m) < threshold) m = uint64_t(uint32_t(operator ()() >> 32)) * n;
+		}
+		return uint32_t(m >> 32);
+	}
+
+	/* advance 2^128 draws */
+	void jump() {
+		static const uint64_t poly[] = { 0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull };
+		uint64_t t[4] = {};
+		for (uint64_t p : poly) {
+			for (int b = 0; b < 64; b++) {
+				if (p & (1ull << b))
+					for (int k = 0; k < 4; k++) t[k] ^= s[k];
+				operator ()();
+			}
+		}
+		for (int k = 0; k < 4; k++) s[k] = t[k];
+	}
+
+private:
+	static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+	uint64_t s[4];
+};
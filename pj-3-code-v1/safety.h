@@ -0,0 +1,199 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * safety.h: Classify the empty points by which sides can still play them
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <bitset>
+#include <cstdint>
+#include "board.h"
+
+/**
+ * the safe-point analysis of NoGo
+ *
+ * since the stones are never removed, the liberties of a block only decrease, hence a move which is illegal now
+ * (suicide or take) remains illegal forever; a point is therefore classified for each side as
+ *   illegal:   the side can never play it
+ *   legal:     both sides can play it now
+ *   exclusive: the side can play it now, but the opponent never can
+ *
+ * the eyes of a side (the empty points surrounded by its own stones or borders) are exclusive points which
+ * never affect the opponent; the blocks linked by the eyes form groups, and a group with e eyes can always
+ * fill e - 1 of them in the order away from the last one, whatever the opponent does, which gives
+ * a lower bound of the remaining moves; the points legal now give an upper bound
+ *
+ * the blocks are kept in a union-find with the liberties as bitsets, so that update() only revisits
+ * the points next to the move and the last liberties of the blocks next to the move
+ */
+template<class board_type>
+class safe_points {
+public:
+	typedef std::bitset<board_type::size_n> points;
+	enum status { illegal = 0, legal = 1, exclusive = 2 };
+
+	safe_points() {}
+	safe_points(const board_type& b) { reset(b); }
+
+	/* analyze the whole board */
+	void reset(const board_type& b) {
+		for (int i = 0; i < board_type::size_n; i++) {
+			parent[i] = i;
+			libs[i].reset();
+		}
+		for (int i = 0; i < board_type::size_n; i++) {
+			if (b(i) != board::black && b(i) != board::white) continue;
+			for (int d = 0; d < 4; d++) {
+				int j = board_type::neighbor(i, d);
+				if (j == i) continue;
+				if (b(j) == board::empty) libs[find(i)].set(j);
+				else if (b(j) == b(i)) unite(i, j);
+			}
+		}
+		for (int c = 0; c < 2; c++) allow[c].reset(), eye[c].reset();
+		for (int i = 0; i < board_type::size_n; i++) {
+			if (b(i) != board::empty) continue;
+			unsigned legal = check(b, i);
+			for (unsigned who = board::black; who <= board::white; who++) {
+				allow[who - 1][i] = legal & who;
+				eye[who - 1][i] = surrounded(b, i, who);
+			}
+		}
+	}
+
+	/* update the analysis after a legal move at point (m) */
+	void update(const board_type& b, int m) {
+		unsigned who = b(m);
+		for (int c = 0; c < 2; c++) allow[c].reset(m), eye[c].reset(m);
+		parent[m] = m;
+		libs[m].reset();
+		for (int d = 0; d < 4; d++) {
+			int j = board_type::neighbor(m, d);
+			if (j == m) continue;
+			if (b(j) == board::empty) libs[m].set(j);
+			else libs[find(j)].reset(m);
+		}
+		points dirty = libs[m]; // the points losing an empty neighbor
+		for (int d = 0; d < 4; d++) {
+			int j = board_type::neighbor(m, d);
+			if (j == m || b(j) == board::empty) continue;
+			if (b(j) == who) unite(m, j);
+			else if (libs[find(j)].count() == 1) dirty |= libs[find(j)];
+		}
+		if (libs[find(m)].count() == 1) dirty |= libs[find(m)];
+
+		// the legality only changes next to m, or at the last liberty of a block
+		for (int i = dirty._Find_first(); i < board_type::size_n; i = dirty._Find_next(i)) {
+			unsigned legal = check(b, i); // the illegal points remain illegal
+			allow[0][i] = allow[0][i] && (legal & board::black);
+			allow[1][i] = allow[1][i] && (legal & board::white);
+		}
+		for (int d = 0; d < 4; d++) {
+			int j = board_type::neighbor(m, d);
+			if (j == m || b(j) != board::empty) continue;
+			eye[who - 1][j] = surrounded(b, j, who);
+			eye[2 - who][j] = false;
+		}
+	}
+
+	status operator ()(int i, unsigned who) const {
+		if (!allow[who - 1][i]) return illegal;
+		return allow[2 - who][i] ? legal : exclusive;
+	}
+	const points& legal_points(unsigned who) const { return allow[who - 1]; }
+
+	/* whether the move only fills an own eye, which changes nothing for the opponent */
+	bool wasted(int i, unsigned who) const { return eye[who - 1][i] && allow[who - 1][i]; }
+
+	/* the upper bound of the remaining moves of a side, optionally within some points */
+	int moves(unsigned who) const { return allow[who - 1].count(); }
+	int moves(unsigned who, const points& within) const { return (allow[who - 1] & within).count(); }
+
+	/* the lower bound of the remaining moves of a side, i.e., the eyes except one of each group */
+	int guaranteed(unsigned who, const points& within = points().set()) const {
+		int16_t link[board_type::size_n], anchor[board_type::size_n];
+		for (int i = 0; i < board_type::size_n; i++) link[i] = i;
+		auto root = [&](int i) {
+			while (link[i] != i) i = link[i] = link[link[i]];
+			return i;
+		};
+		const points own = eye[who - 1] & within;
+		int eyes = 0, groups = 0;
+		for (int i = own._Find_first(); i < board_type::size_n; i = own._Find_next(i)) {
+			anchor[i] = -1;
+			for (int d = 0; d < 4; d++) { // link the blocks around the eye
+				int j = board_type::neighbor(i, d);
+				if (j == i) continue;
+				int r = root(find(j));
+				if (anchor[i] == -1) anchor[i] = r;
+				else if (r != root(anchor[i])) link[r] = root(anchor[i]);
+			}
+			eyes += (anchor[i] != -1);
+		}
+		points seen;
+		for (int i = own._Find_first(); i < board_type::size_n; i = own._Find_next(i)) {
+			if (anchor[i] == -1) continue;
+			int r = root(anchor[i]);
+			if (!seen[r]) seen.set(r), groups++;
+		}
+		return eyes - groups;
+	}
+
+	/**
+	 * decide the winner by the bounds when who is to move, or return board::empty if undecided
+	 * who wins if it can move more times than the opponent in any case, and vice versa
+	 */
+	board::piece_type decided(unsigned who) const {
+		unsigned opp = 3u - who;
+		int my_moves = moves(who), opp_moves = moves(opp);
+		// the number of eyes bounds the guaranteed moves, which is checked first as it is much cheaper
+		if (int(eye[who - 1].count()) > opp_moves && guaranteed(who) > opp_moves) return board::piece_type(who);
+		if (int(eye[opp - 1].count()) >= my_moves && guaranteed(opp) >= my_moves) return board::piece_type(opp);
+		return board::empty;
+	}
+
+protected:
+	int find(int i) const {
+		while (parent[i] != i) i = parent[i] = parent[parent[i]];
+		return i;
+	}
+	void unite(int a, int b) {
+		a = find(a), b = find(b);
+		if (a == b) return;
+		parent[b] = a;
+		libs[a] |= libs[b];
+	}
+
+	/* whether the empty point (i) is legal for black (bit 1) and white (bit 2), see basic_board::place */
+	unsigned check(const board_type& b, int i) const {
+		unsigned breath = 0, take = 0;
+		for (int d = 0; d < 4; d++) {
+			int j = board_type::neighbor(i, d);
+			if (j == i) continue;
+			unsigned who = b(j);
+			if (who == board::empty) breath = board::black | board::white;
+			else if (libs[find(j)].count() >= 2) breath |= who; // a liberty other than (i)
+			else take |= 3u - who; // the opponent would take the block, and the block gives no breath
+		}
+		return breath & ~take;
+	}
+	static bool surrounded(const board_type& b, int i, unsigned who) {
+		bool any = false;
+		for (int d = 0; d < 4; d++) {
+			int j = board_type::neighbor(i, d);
+			if (j == i) continue;
+			if (b(j) != who) return false;
+			any = true;
+		}
+		return any;
+	}
+
+private:
+	mutable int16_t parent[board_type::size_n];
+	points libs[board_type::size_n]; /* the liberties of the blocks, valid at the roots */
+	points allow[2];                 /* the legal points of black and white */
+	points eye[2];                   /* the eyes of black and white */
+};
@@ -0,0 +1,248 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * selfplay.h: Self-play games written as training samples into binary shards
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <condition_variable>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "options.h"
+#include "threads.h"
+
+/**
+ * a training sample of a position, which is a fixed-size record in the shards
+ */
+template<class board_type>
+struct sample {
+	uint8_t cells[board_type::size_n];   /* the cells of the position, see board::cell */
+	uint8_t tomove;                      /* the side to move */
+	int8_t outcome;                      /* +1 if the side to move won the game, -1 otherwise */
+	uint16_t visits[board_type::size_n]; /* the root visits of the moves, clamped to 65535 */
+};
+
+/**
+ * the writer of the samples into the shards of a directory, which runs in background, so that the games never wait for I/O
+ *
+ * each shard is a header followed by the records, and holds whole games of at most capacity records;
+ * the shards are listed in the index, one line "<file> <records> <games>" per shard, where games is the number of
+ * games in all shards so far; a shard is listed only after it is complete, so a restarted writer continues after
+ * the last listed shard, and overwrites the unlisted one; if a shard cannot be written, the error is reported,
+ * and the writer drops the games since then and refuses the new ones, see push
+ */
+template<class board_type>
+class shard_writer {
+public:
+	struct header {
+		char magic[8];      /* "NOGOSHRD" */
+		uint32_t version;
+		uint16_t size_x, size_y;
+		uint32_t record_size, count;
+	};
+
+	shard_writer(const std::string& dir, size_t capacity = 1 << 16)
+		: dir(dir), capacity(std::max<size_t>(capacity, 1)), shards(0), total(0), done(0), stopping(false), failed(false) {
+		mkdir(dir.c_str(), 0755);
+		std::ifstream index(path("index.txt"));
+		for (std::string file; index >> file >> records >> done; shards++);
+		records = 0;
+		thread = std::thread(&shard_writer::work, this);
+	}
+	shard_writer(const shard_writer&) = delete;
+	~shard_writer() { finish(); }
+
+	/* write the queued games and complete the last shard, and return false if the shards failed to be written */
+	bool finish() {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stopping = true;
+		}
+		wake.notify_all();
+		if (thread.joinable()) thread.join();
+		if (records && !failed) close();
+		return !failed;
+	}
+
+	/* the games in the listed shards when the writer started */
+	size_t games() const { return done; }
+
+	/* queue the samples of a game, and return false if the writer has failed, so that no more games should be played */
+	bool push(std::vector<sample<board_type>>&& game) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (failed) return false;
+			queue.push_back(std::move(game));
+		}
+		wake.notify_one();
+		return true;
+	}
+
+protected:
+	std::string path(const std::string& file) const { return dir + "/" + file; }
+	std::string name(size_t id) const {
+		std::stringstream buf;
+		buf << "shard-" << std::setw(5) << std::setfill('0') << id << ".bin";
+		return buf.str();
+	}
+
+	void work() {
+		for (;;) {
+			std::vector<sample<board_type>> game;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				wake.wait(lock, [&]() { return stopping || queue.size(); });
+				if (queue.empty()) return;
+				game = std::move(queue.front());
+				queue.pop_front();
+			}
+			try {
+				if (records && records + game.size() > capacity) close();
+				if (records == 0) open();
+				out.write(reinterpret_cast<const char*>(game.data()), game.size() * sizeof(sample<board_type>));
+				if (!out) throw std::runtime_error("cannot write shard: " + path(name(shards)));
+			} catch (const std::exception& e) { // never let it escape the thread, which would terminate the program
+				std::cerr << "selfplay: " << e.what() << std::endl;
+				std::lock_guard<std::mutex> lock(mtx);
+				failed = true;
+				queue.clear();
+				return;
+			}
+			records += game.size();
+			total++;
+		}
+	}
+
+	void open() {
+		out.open(path(name(shards)), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) throw std::runtime_error("cannot open shard: " + path(name(shards)));
+		header head = make_header(0);
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+	}
+
+	/* complete the shard with its count, and then list it in the index */
+	void close() {
+		header head = make_header(records);
+		out.seekp(0);
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		out.close();
+		done += total;
+		std::ofstream index(path("index.txt"), std::ios::out | std::ios::app);
+		index << name(shards) << " " << records << " " << done << std::endl;
+		std::cout << name(shards) << "\t" << "records = " << records << ", games = " << done << std::endl;
+		shards++, records = 0, total = 0;
+	}
+
+	static header make_header(uint32_t count) {
+		header head;
+		std::memcpy(head.magic, "NOGOSHRD", 8);
+		head.version = 1;
+		head.size_x = board_type::size_x, head.size_y = board_type::size_y;
+		head.record_size = sizeof(sample<board_type>);
+		head.count = count;
+		return head;
+	}
+
+private:
+	std::string dir;
+	size_t capacity;
+	size_t shards, records, total, done; /* total is the games in the open shard, done is the games in the listed shards */
+	std::ofstream out;
+	std::deque<std::vector<sample<board_type>>> queue;
+	std::mutex mtx;
+	std::condition_variable wake;
+	bool stopping, failed; /* guarded by mtx, failed is set by the writer thread only */
+	std::thread thread;
+};
+
+/**
+ * the self-play of a player configuration in parallel games, which writes a sample of each move
+ * options: games (in total, including the ones of earlier runs), thread, output (the directory), shard (the records per shard)
+ */
+template<class board_type>
+class self_play {
+public:
+	self_play(const std::string& config, const std::string& args = "")
+		: config(config), total(1000), threads(1), output("selfplay"), capacity(1 << 16) {
+		std::map<std::string, std::string> meta = parse_options(args);
+		if (meta.count("games")) total = std::stoull(meta["games"]);
+		if (meta.count("thread")) threads = std::max(std::stoi(meta["thread"]), 1);
+		if (meta.count("output")) output = meta["output"];
+		if (meta.count("shard")) capacity = std::stoull(meta["shard"]);
+	}
+
+	/* play the games until the total, and return false if the shards failed to be written */
+	bool run() {
+		shard_writer<board_type> writer(output, capacity);
+		std::atomic<size_t> next{writer.games()};
+		uint64_t seed = std::random_device()();
+		run_threads(threads, [&](int k) {
+			player<board_type> black("seed=" + std::to_string(seed + k * 2) + " name=black " + config + " role=black");
+			player<board_type> white("seed=" + std::to_string(seed + k * 2 + 1) + " name=white " + config + " role=white");
+			while (next++ < total && writer.push(play(black, white)));
+		});
+		return writer.finish();
+	}
+
+	/* play a game, and return the samples of its moves */
+	static std::vector<sample<board_type>> play(player<board_type>& black, player<board_type>& white) {
+		std::vector<sample<board_type>> samples;
+		episode<board_type> game;
+		black.open_episode("~:" + white.name());
+		white.open_episode(black.name() + ":~");
+		game.open_episode(black.name() + ":" + white.name());
+		while (true) {
+			player<board_type>& who = (game.step() % 2) ? white : black;
+			game.take_turns(black, white);
+			board_type state = game.state();
+			action move = who.take_action(state);
+			if (game.apply_action(move) != true) break;
+			sample<board_type> x;
+			std::memset(&x, 0, sizeof(x)); // also the padding, so that the shards are reproducible byte by byte
+			for (int i = 0; i < board_type::size_n; i++) {
+				x.cells[i] = state(i);
+				x.visits[i] = std::min(who.root_visits()[i], 65535);
+			}
+			x.tomove = state.info().who_take_turns;
+			if (std::count(x.visits, x.visits + board_type::size_n, 0) == board_type::size_n) // not searched by MCTS
+				x.visits[action::place(move).position<board_type>().i] = 1;
+			samples.push_back(x);
+			if (who.check_for_win(game.state())) break;
+		}
+		agent<board_type>& win = game.last_turns(black, white);
+		board::piece_type winner = (&win == &black) ? board::black : board::white;
+		for (sample<board_type>& x : samples) x.outcome = (x.tomove == winner) ? 1 : -1;
+		game.close_episode(win.name());
+		black.close_episode(win.name());
+		white.close_episode(win.name());
+		return samples;
+	}
+
+private:
+	std::string config;
+	size_t total;
+	int threads;
+	std::string output;
+	size_t capacity;
+};
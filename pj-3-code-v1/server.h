@@ -0,0 +1,269 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * server.h: The GTP server of many concurrent sessions in one process
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "options.h"
+
+/**
+ * the slots of the threads shared by the searches of all sessions, where a search takes one slot per thread
+ * (at most all slots), and the requests are granted in their order, so that a session never waits for more than
+ * the searches requested before its own, and the cores are never oversubscribed
+ */
+class search_slots {
+public:
+	search_slots(size_t n) : total(std::max<size_t>(n, 1)), available(total), tickets(0), serving(0) {}
+	search_slots(const search_slots&) = delete;
+
+	/* acquire n slots, and return the number acquired */
+	size_t acquire(size_t n = 1) {
+		n = std::min(std::max<size_t>(n, 1), total);
+		std::unique_lock<std::mutex> lock(mtx);
+		size_t ticket = tickets++;
+		cv.wait(lock, [&]() { return ticket == serving && available >= n; });
+		serving++, available -= n;
+		cv.notify_all(); // the next ticket may also be granted
+		return n;
+	}
+	void release(size_t n = 1) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			available += n;
+		}
+		cv.notify_all();
+	}
+
+	/* hold n slots in the scope */
+	struct hold {
+		hold(search_slots& slots, size_t n = 1) : slots(slots), n(slots.acquire(n)) {}
+		~hold() { slots.release(n); }
+		search_slots& slots;
+		size_t n;
+	};
+
+private:
+	size_t total, available, tickets, serving;
+	std::mutex mtx;
+	std::condition_variable cv;
+};
+
+/**
+ * the player whose searches run in the slots of its threads, see search_slots
+ * the time of a search starts after its slots are granted, so the budget of a session is not taken by the others
+ */
+template<class board_type>
+class scheduled_player : public player<board_type> {
+public:
+	scheduled_player(search_slots& slots, const std::string& args = "") : player<board_type>(args), slots(slots) {}
+
+	virtual action take_action(const board_type& state) {
+		search_slots::hold slot(slots, this->concurrency());
+		return player<board_type>::take_action(state);
+	}
+
+	/* analyze in rounds of about the report interval, and give the slots back between the rounds, so that
+	// an analysis waiting for "stop" never starves the other sessions; search=MCTS resumes its tree in each round */
+	virtual action analyze(const board_type& state, std::function<void(const std::string&)> hook, double interval = 1.0, double round = 0) {
+		action best_action;
+		do {
+			search_slots::hold slot(slots, this->concurrency());
+			best_action = player<board_type>::analyze(state, hook, interval, std::max(interval * 1.05, 0.05));
+		} while (this->is_interrupted() == false);
+		return best_action;
+	}
+
+private:
+	search_slots& slots;
+};
+
+/**
+ * the streams of a connected socket, whose output is sent when flushed, e.g., by std::endl
+ *
+ * the input and the output are separate streams over one buffer, since they are used by different threads
+ * (the command reader and the shell), and the end of the input (e.g., a client which shuts down its sending side
+ * after the last command) must not fail the replies to the commands still queued
+ */
+class socket_stream {
+public:
+	socket_stream(int fd) : buf(fd), in(&buf), out(&buf) {}
+
+	/* shut down the connection, so that a blocked reader returns as the end of the stream */
+	void hangup() { ::shutdown(buf.fd, SHUT_RDWR); }
+
+protected:
+	class buffer : public std::streambuf {
+	public:
+		buffer(int fd) : fd(fd) {
+			setg(input, input, input);
+			setp(output, output + sizeof(output));
+		}
+		int fd;
+
+	protected:
+		int underflow() {
+			ssize_t n;
+			while ((n = ::recv(fd, input, sizeof(input), 0)) < 0 && errno == EINTR);
+			if (n <= 0) return traits_type::eof();
+			setg(input, input, input + n);
+			return traits_type::to_int_type(*gptr());
+		}
+		int overflow(int c) {
+			if (sync() != 0) return traits_type::eof();
+			if (c != traits_type::eof()) *pptr() = c, pbump(1);
+			return traits_type::not_eof(c);
+		}
+		int sync() {
+			for (char* p = pbase(); p < pptr(); ) {
+				ssize_t n = ::send(fd, p, pptr() - p, MSG_NOSIGNAL);
+				if (n < 0 && errno == EINTR) continue;
+				if (n <= 0) return -1;
+				p += n;
+			}
+			setp(output, output + sizeof(output));
+			return 0;
+		}
+
+	private:
+		char input[4096], output[4096];
+	};
+	buffer buf;
+
+public:
+	std::istream in;
+	std::ostream out;
+};
+
+/**
+ * the server which accepts the GTP sessions over TCP or a Unix socket, and serves each of them in its own thread,
+ * while all searches share the slots, see search_slots
+ *
+ * the address is "<port>" or "<host>:<port>" for TCP (port 0 for any free port), or "unix:<path>" for a Unix socket
+ * options: slot (the threads of the concurrent searches, all cores by default), session (the concurrent sessions, 64 by default;
+ * the other connections wait to be accepted)
+ */
+class gtp_server {
+public:
+	gtp_server(const std::string& args)
+		: slots(nullptr), sessions(64), live(0), fd(-1) {
+		std::stringstream ss(args);
+		ss >> address;
+		std::map<std::string, std::string> meta = parse_options(ss);
+		size_t n = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		if (meta.count("slot")) n = std::stoull(meta["slot"]);
+		if (meta.count("session")) sessions = std::max<size_t>(std::stoull(meta["session"]), 1);
+		slots.reset(new search_slots(n));
+		listen();
+	}
+	gtp_server(const gtp_server&) = delete;
+	~gtp_server() {
+		if (fd >= 0) ::close(fd);
+		if (address.compare(0, 5, "unix:") == 0) ::unlink(address.substr(5).c_str());
+	}
+
+	search_slots& scheduler() { return *slots; }
+
+	/* the bound address, e.g., "127.0.0.1:10000" or "unix:/tmp/nogo.sock" */
+	const std::string& bound() const { return address; }
+
+	/* accept and serve the sessions forever, where the session returns when its input is closed */
+	void run(std::function<void(socket_stream&)> session) {
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait(lock, [&]() { return live < sessions; });
+			}
+			int client = ::accept(fd, nullptr, nullptr);
+			if (client < 0) {
+				if (errno == EINTR || errno == ECONNABORTED) continue;
+				throw std::runtime_error(std::string("accept: ") + std::strerror(errno));
+			}
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				live++;
+			}
+			std::thread([this, client, session]() {
+				try {
+					socket_stream io(client);
+					session(io);
+				} catch (std::exception& e) {
+					std::cerr << "session error: " << e.what() << std::endl;
+				}
+				::close(client);
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					live--;
+				}
+				cv.notify_all();
+			}).detach();
+		}
+	}
+
+protected:
+	void listen() {
+		if (address.compare(0, 5, "unix:") == 0) {
+			sockaddr_un addr = {};
+			addr.sun_family = AF_UNIX;
+			std::string path = address.substr(5);
+			if (path.empty() || path.size() >= sizeof(addr.sun_path)) throw std::invalid_argument("invalid address: " + address);
+			std::strcpy(addr.sun_path, path.c_str());
+			::unlink(path.c_str());
+			fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+				throw std::runtime_error("cannot bind " + address + ": " + std::strerror(errno));
+		} else {
+			sockaddr_in addr = {};
+			addr.sin_family = AF_INET;
+			std::string host = "0.0.0.0", port = address;
+			if (address.find(':') != std::string::npos)
+				host = address.substr(0, address.find(':')), port = address.substr(address.find(':') + 1);
+			if (port.empty() || port.find_first_not_of("0123456789") != std::string::npos
+					|| ::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+				throw std::invalid_argument("invalid address: " + address);
+			addr.sin_port = htons(std::stoi(port));
+			fd = ::socket(AF_INET, SOCK_STREAM, 0);
+			int reuse = 1;
+			if (fd >= 0) ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+			if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+				throw std::runtime_error("cannot bind " + address + ": " + std::strerror(errno));
+			socklen_t size = sizeof(addr);
+			::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &size);
+			address = host + ":" + std::to_string(ntohs(addr.sin_port)); // the port chosen for port 0
+		}
+		if (::listen(fd, 128) != 0)
+			throw std::runtime_error("cannot listen " + address + ": " + std::strerror(errno));
+	}
+
+private:
+	std::unique_ptr<search_slots> slots;
+	size_t sessions, live;
+	std::string address;
+	int fd;
+	std::mutex mtx;
+	std::condition_variable cv;
+};
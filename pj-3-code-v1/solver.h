@@ -0,0 +1,202 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * solver.h: Proof-number search for proving or disproving the win of the side to move
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+#include "board.h"
+
+/**
+ * proof-number search of NoGo in the negamax form, i.e., every node is an OR node of its side to move:
+ *   pn(n) = min { dn(c) } and dn(n) = sum { pn(c) } over the children c of n,
+ * where the side to move without any legal move loses, i.e., pn = inf and dn = 0; there is no draw in NoGo
+ *
+ * two variants are provided:
+ *   pns:  the best-first proof-number search with an explicit tree of moves, whose memory grows with the budget
+ *   dfpn: the depth-first proof-number search (Nagai 2002) with a fixed-size transposition table;
+ *         since NoGo never repeats a position, the search graph is acyclic and the plain df-pn is sound
+ * the transposition table of dfpn is kept across calls, so that repeated calls reuse the earlier work
+ */
+template<class board_type>
+class proof_solver {
+public:
+	enum result { unknown = 0, win = 1, loss = 2 }; // for the side to move
+	enum variant { pns, dfpn };
+	static constexpr uint32_t inf = 1u << 30;
+
+	proof_solver(variant mode = dfpn, size_t table_bits = 18) : mode(mode), table(size_t(1) << table_bits) {}
+
+	/**
+	 * prove the state for the side to move (who) within the budget of expanded nodes,
+	 * stop is polled every few hundred nodes, e.g., for the time limit
+	 * return win, loss, or unknown, and the best move is available by best_move()
+	 */
+	result solve(const board_type& state, unsigned who, size_t budget, std::function<bool()> stop = nullptr) {
+		limit = budget;
+		expanded = 0;
+		halt = stop;
+		aborted = false;
+		best = -1;
+		board_type root = state;
+		root.info({ board::piece_type(who) });
+		return mode == pns ? search_pns(root) : search_dfpn(root);
+	}
+
+	/* the result of the state already proven by the earlier calls of df-pn, without expanding any node */
+	result known(const board_type& state, unsigned who) {
+		if (mode != dfpn) return unknown;
+		board_type root = state;
+		root.info({ board::piece_type(who) });
+		entry e = lookup(root);
+		if (e.pn != 0 && e.dn != 0) return unknown;
+		pick(root);
+		return e.pn == 0 ? win : loss;
+	}
+
+	/* the proven move if the root is a win, or the most promising move otherwise, -1 if none */
+	int best_move() const { return best; }
+	size_t nodes() const { return expanded; }
+	variant get_mode() const { return mode; }
+
+protected:
+	struct child {
+		board_type state;
+		int move;
+	};
+
+	/* list the children of the state, the side to move is given by the state */
+	static std::vector<child> generate(const board_type& state) {
+		std::vector<child> children;
+		for (int i = 0; i < board_type::size_n; i++) {
+			board_type after = state;
+			if (after.place(typename board_type::point(i)) == board::legal)
+				children.push_back({ after, i });
+		}
+		return children;
+	}
+
+	bool out_of_budget() {
+		if (++expanded >= limit) aborted = true;
+		if ((expanded & 255) == 0 && halt && halt()) aborted = true;
+		return aborted;
+	}
+
+	static uint32_t add(uint32_t a, uint32_t b) { return std::min(a + b, inf); }
+
+	/******************* df-pn **************************/
+	struct entry {
+		uint64_t key = 0;
+		uint32_t pn = 1, dn = 1;
+	};
+	static uint64_t key_of(const board_type& b) { return b.hash() ^ (b.info().who_take_turns == board::white ? ~0ull : 0ull); }
+	entry lookup(const board_type& b) const {
+		const entry& e = table[key_of(b) & (table.size() - 1)];
+		return e.key == key_of(b) ? e : entry();
+	}
+	void store(const board_type& b, uint32_t pn, uint32_t dn) {
+		// always replace, since a node must find its own numbers after the search of it returns
+		entry& e = table[key_of(b) & (table.size() - 1)];
+		e.key = key_of(b), e.pn = pn, e.dn = dn;
+	}
+
+	result search_dfpn(const board_type& root) {
+		mid(root, inf - 1, inf - 1);
+		entry e = lookup(root);
+		pick(root);
+		return e.pn == 0 ? win : e.dn == 0 ? loss : unknown;
+	}
+
+	/* the proven move, or the most promising one */
+	void pick(const board_type& root) {
+		uint32_t low = inf + 1;
+		best = -1;
+		for (const child& c : generate(root)) {
+			entry x = lookup(c.state);
+			if (x.dn < low) low = x.dn, best = c.move;
+		}
+	}
+
+	void mid(const board_type& node, uint32_t thpn, uint32_t thdn) {
+		if (out_of_budget()) return;
+		std::vector<child> children = generate(node);
+		if (children.empty()) {
+			store(node, inf, 0);
+			return;
+		}
+		while (!aborted) {
+			uint32_t pn = inf, dn = 0, dn1 = inf, dn2 = inf;
+			size_t select = 0;
+			for (size_t k = 0; k < children.size(); k++) {
+				entry e = lookup(children[k].state);
+				pn = std::min(pn, e.dn);
+				dn = add(dn, e.pn);
+				if (e.dn < dn1) dn2 = dn1, dn1 = e.dn, select = k;
+				else if (e.dn < dn2) dn2 = e.dn;
+			}
+			store(node, pn, dn);
+			if (pn >= thpn || dn >= thdn) return;
+			entry c = lookup(children[select].state);
+			uint32_t child_pn = std::min<uint64_t>(uint64_t(thdn) - dn + c.pn, inf - 1);
+			uint32_t child_dn = std::min(thpn, add(dn2, dn2 / 4 + 1)); // the 1+epsilon trick against the seesaw effect
+			mid(children[select].state, child_pn, child_dn);
+		}
+	}
+
+	/******************* best-first PNS **************************/
+	struct node {
+		int move, parent;
+		uint32_t pn = 1, dn = 1;
+		std::vector<int> children;
+		bool expanded = false;
+		node(int move, int parent) : move(move), parent(parent) {}
+	};
+
+	result search_pns(const board_type& root) {
+		std::vector<node> tree; // only the moves are kept, the states are replayed from the root
+		tree.emplace_back(-1, -1);
+		while (tree[0].pn != 0 && tree[0].dn != 0 && !out_of_budget()) {
+			int n = 0;
+			board_type state = root;
+			while (tree[n].expanded) { // the most-proving node, following the child of the least dn
+				int select = tree[n].children[0];
+				for (int c : tree[n].children)
+					if (tree[c].dn < tree[select].dn) select = c;
+				n = select;
+				state.place(typename board_type::point(tree[n].move));
+			}
+			tree[n].expanded = true;
+			for (const child& c : generate(state)) {
+				tree[n].children.push_back(tree.size());
+				tree.emplace_back(c.move, n);
+			}
+			for (; n != -1; n = tree[n].parent) { // update the ancestors
+				uint32_t pn = inf, dn = 0;
+				for (int c : tree[n].children) pn = std::min(pn, tree[c].dn), dn = add(dn, tree[c].pn);
+				if (pn == tree[n].pn && dn == tree[n].dn) break;
+				tree[n].pn = pn, tree[n].dn = dn;
+			}
+		}
+		uint32_t low = inf + 1;
+		for (int c : tree[0].children)
+			if (tree[c].dn < low) low = tree[c].dn, best = tree[c].move;
+		return tree[0].pn == 0 ? win : tree[0].dn == 0 ? loss : unknown;
+	}
+
+private:
+	variant mode;
+	std::vector<entry> table;
+	size_t limit = 0, expanded = 0;
+	std::function<bool()> halt;
+	bool aborted = false;
+	int best = -1;
+};
+
+template<class board_type> constexpr uint32_t proof_solver<board_type>::inf;
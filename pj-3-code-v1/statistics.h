@@ -9,13 +9,61 @@
 
 #pragma once
 #include <deque>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
 #include "board.h"
 #include "action.h"
 #include "episode.h"
+#include "probe.h"
 
+/**
+ * the histogram of the move latencies in microseconds, in log buckets of 8 sub-buckets per power of two,
+ * so that a percentile is reported within 12.5% above the exact one
+ */
+class latency_histogram {
+public:
+	latency_histogram() : counts(buckets, 0), total(0), most(0) {}
+
+	void add(uint64_t usec) {
+		counts[index(usec)]++;
+		total++;
+		most = std::max(most, usec);
+	}
+	size_t size() const { return total; }
+	uint64_t max() const { return most; }
+
+	/* the upper bound of the bucket of the percentile, e.g., p = 0.99 */
+	uint64_t percentile(double p) const {
+		size_t rank = std::max<size_t>(std::ceil(p * total), 1), seen = 0;
+		for (size_t i = 0; i < counts.size() && total; i++)
+			if ((seen += counts[i]) >= rank) return std::min(upper(i), most);
+		return most;
+	}
+
+private:
+	static constexpr int sub = 8, buckets = 64 * sub;
+	static size_t index(uint64_t v) {
+		if (v < sub) return v;
+		int e = 63 - __builtin_clzll(v);
+		return (e - 2) * sub + ((v >> (e - 3)) & (sub - 1));
+	}
+	static uint64_t upper(size_t i) {
+		if (i < sub) return i;
+		int e = i / sub + 2;
+		return ((sub + i % sub + 1) << (e - 3)) - 1;
+	}
+
+	std::vector<size_t> counts;
+	size_t total;
+	uint64_t most;
+};
+
+template<class board_type = board>
 class statistics {
 public:
 	/**
@@ -47,11 +95,15 @@ public:
 	 *  'ops = 125762 (132018|135377)': the average speed is 125762
 	 *                                  the average speed of black is 132018
 	 *                                  the average speed of white is 135377
+	 *
+	 * followed by the move latencies of each player, e.g.,
+	 * 	black	time = 10.240|13.311|18.431|24.102 ms, opening = ..., midgame = ..., endgame = ...
+	 * where each is p50|p90|p99|max, of all moves and of the moves in each phase, see phase
 	 */
 	void show(size_t blk = 0) const {
 		size_t num = std::min(data.size(), blk ?: block);
 		size_t sop = 0, Bop = 0, Wop = 0;
-		time_t sdu = 0, Bdu = 0, Wdu = 0;
+		time_t sdu = 0, Bdu = 0, Wdu = 0; // in milliseconds, and in microseconds for the players
 		size_t BW = 0, WW = 0;
 		auto it = data.end();
 		for (size_t i = 0; i < num; i++) {
@@ -62,8 +114,7 @@ public:
 			Bop += ep.step(action::black::type);
 			Wop += ep.step(action::white::type);
 			sdu += ep.time();
-			Bdu += ep.time(action::black::type);
-			Wdu += ep.time(action::white::type);
+			for (size_t k = 0; k < ep.step(); k++) (k % 2 ? Wdu : Bdu) += ep.latency(k);
 		}
 
 		std::cout << count << "\t";
@@ -73,9 +124,39 @@ public:
 		          <<     " (" << (Bop * 1.0 / num)
 		          <<      "|" << (Wop * 1.0 / num) << "), ";
 		std::cout << "ops = " << (sop * 1000.0 / sdu)
-		          <<     " (" << (Bop * 1000.0 / Bdu)
-		          <<      "|" << (Wop * 1000.0 / Wdu) << ")";
+		          <<     " (" << (Bop * 1000000.0 / Bdu)
+		          <<      "|" << (Wop * 1000000.0 / Wdu) << ")";
 		std::cout << std::endl;
+
+		latency_histogram latency[2][4]; // of black and white, in the phases and in all
+		it = data.end();
+		for (size_t i = 0; i < num; i++) {
+			auto& ep = *(--it);
+			for (size_t k = 0; k < ep.step(); k++) {
+				latency[k % 2][phase(k)].add(ep.latency(k));
+				latency[k % 2][3].add(ep.latency(k));
+			}
+		}
+		auto quantiles = [](const latency_histogram& h) {
+			std::stringstream buf;
+			buf << std::fixed << std::setprecision(3);
+			buf << h.percentile(0.5) / 1000.0 << "|" << h.percentile(0.9) / 1000.0 << "|"
+			    << h.percentile(0.99) / 1000.0 << "|" << h.max() / 1000.0;
+			return buf.str();
+		};
+		const char* names[] = { "black", "white" };
+		for (int who = 0; who < 2; who++) {
+			if (latency[who][3].size() == 0) continue;
+			std::cout << "\t" << names[who] << "\t" << "time = " << quantiles(latency[who][3]) << " ms, "
+			          << "opening = " << quantiles(latency[who][0]) << ", "
+			          << "midgame = " << quantiles(latency[who][1]) << ", "
+			          << "endgame = " << quantiles(latency[who][2]) << std::endl;
+		}
+	}
+
+	/* the phase of the k-th move of a game: the opening fills 1/5 of the board, and the midgame fills up to 1/2 */
+	static int phase(size_t k) {
+		return k < board_type::size_n / 5 ? 0 : k < board_type::size_n / 2 ? 1 : 2;
 	}
 
 	void summary() const {
@@ -98,16 +179,16 @@ public:
 
 	void close_episode(const std::string& flag = "") {
 		data.back().close_episode(flag);
-		if (count % block == 0) show();
+		if (count % block == 0) show(), probe::dump(std::cout);
 	}
 
-	episode& at(size_t i) {
+	episode<board_type>& at(size_t i) {
 		return data.at(i);
 	}
-	episode& front() {
+	episode<board_type>& front() {
 		return data.front();
 	}
-	episode& back() {
+	episode<board_type>& back() {
 		return data.back();
 	}
 	size_t step() const {
@@ -115,7 +196,7 @@ public:
 	}
 
 	friend std::ostream& operator <<(std::ostream& out, const statistics& stat) {
-		for (const episode& rec : stat.data) out << rec << std::endl;
+		for (const episode<board_type>& rec : stat.data) out << rec << std::endl;
 		return out;
 	}
 	friend std::istream& operator >>(std::istream& in, statistics& stat) {
@@ -133,5 +214,5 @@ private:
 	size_t block;
 	size_t limit;
 	size_t count;
-	std::deque<episode> data;
+	std::deque<episode<board_type>> data;
 };
@@ -0,0 +1,176 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * threads.h: The persistent thread pool with work-stealing task queues
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * the thread pool which lives as long as its owner, so that no thread is created or joined per move
+ *
+ * each worker owns a task queue, where it takes the latest task of its own queue first, and steals
+ * the oldest task of the others when its own queue is empty; the tasks submitted by a worker go to its
+ * own queue, and the tasks from outside are spread over the queues in turn
+ *
+ * index() tells the worker running the current thread, 1 to size() for the workers and 0 for any other
+ * thread, so that the per-thread resources (e.g., the node pools) can be indexed by it
+ */
+class thread_pool {
+public:
+	/* start n workers, which are pinned to the CPUs in turn if pin is set (Linux only) */
+	thread_pool(int n, bool pin = false) : queues(std::max(n, 1)) {
+		for (auto& q : queues) q.reset(new queue);
+		for (int k = 0; k < int(queues.size()); k++) {
+			threads.emplace_back(&thread_pool::work, this, k);
+			if (pin) affinity(threads.back(), k);
+		}
+	}
+	thread_pool(const thread_pool&) = delete;
+	~thread_pool() {
+		wait();
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& t : threads) t.join();
+	}
+
+	int size() const { return int(queues.size()); }
+	static int index() { return current(); }
+
+	/* run the task later on any worker */
+	void submit(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			++pending;
+		}
+		int k = (index() ? index() - 1 : int(next++ % queues.size()));
+		{
+			std::lock_guard<std::mutex> lock(queues[k]->mtx);
+			queues[k]->tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			++queued;
+		}
+		wake.notify_one();
+	}
+
+	/* run fn(0) to fn(n - 1) as tasks and wait for all of them; a worker calling it helps instead of blocking */
+	void run(int n, const std::function<void(int)>& fn) {
+		int left = n;
+		std::mutex m;
+		std::condition_variable done;
+		for (int k = 0; k < n; k++) {
+			submit([&, k]() {
+				fn(k);
+				std::lock_guard<std::mutex> lock(m);
+				if (--left == 0) done.notify_all();
+			});
+		}
+		std::unique_lock<std::mutex> lock(m);
+		while (left) {
+			if (index()) {
+				lock.unlock();
+				if (!execute(index() - 1)) std::this_thread::yield();
+				lock.lock();
+			} else {
+				done.wait(lock);
+			}
+		}
+	}
+
+	/* wait until all submitted tasks, including the ones submitted by the tasks, are finished (not for the workers) */
+	void wait() {
+		std::unique_lock<std::mutex> lock(mtx);
+		idle.wait(lock, [&]() { return pending == 0; });
+	}
+
+protected:
+	struct queue {
+		std::mutex mtx;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	static int& current() {
+		static thread_local int k = 0;
+		return k;
+	}
+
+	void work(int k) {
+		current() = k + 1;
+		for (;;) {
+			if (execute(k)) continue;
+			std::unique_lock<std::mutex> lock(mtx);
+			wake.wait(lock, [&]() { return stopping || queued > 0; });
+			if (stopping && queued <= 0) return;
+		}
+	}
+
+	/* take a task of the own queue, or steal one from the others, and run it */
+	bool execute(int k) {
+		std::function<void()> task;
+		for (size_t s = 0; s < queues.size() && !task; s++) {
+			queue& q = *queues[(k + s) % queues.size()];
+			std::lock_guard<std::mutex> lock(q.mtx);
+			if (q.tasks.empty()) continue;
+			if (s == 0) task = std::move(q.tasks.back()), q.tasks.pop_back();
+			else task = std::move(q.tasks.front()), q.tasks.pop_front();
+		}
+		if (!task) return false;
+		--queued;
+		task();
+		std::lock_guard<std::mutex> lock(mtx);
+		if (--pending == 0) idle.notify_all();
+		return true;
+	}
+
+	static void affinity(std::thread& t, int k) {
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(k % std::max(1u, std::thread::hardware_concurrency()), &set);
+		pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#endif
+	}
+
+private:
+	std::vector<std::unique_ptr<queue>> queues;
+	std::vector<std::thread> threads;
+	std::mutex mtx;
+	std::condition_variable wake, idle;
+	std::atomic<int> queued{0};
+	size_t pending = 0; /* the tasks submitted but not finished, guarded by mtx */
+	std::atomic<size_t> next{0};
+	bool stopping = false;
+};
+
+/**
+ * run task(k) for k = 0 to n - 1 on n plain threads, and join them
+ *
+ * the modes which run many players at once (e.g., match, tune, selfplay, analyze) use plain threads rather than
+ * a thread_pool, since the players index their per-thread resources by thread_pool::index() of their own pools;
+ * each task keeps its players on its stack, since they are over-aligned for the operator new of C++ 11
+ */
+inline void run_threads(int n, std::function<void(int)> task) {
+	std::vector<std::thread> workers;
+	for (int k = 0; k < n; k++) workers.emplace_back(task, k);
+	for (std::thread& t : workers) t.join();
+}
@@ -0,0 +1,127 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * tune.h: The SPSA tuner of the UCT constant and the time schedule by parallel self-play
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "board.h"
+#include "agent.h"
+#include "match.h"
+#include "rng.h"
+#include "options.h"
+#include "threads.h"
+
+/**
+ * simultaneous perturbation stochastic approximation (Spall 1998) of the player parameters
+ *
+ * the parameters are tuned in the log scale: the UCT constant, and the weights of the six phases of the time schedule
+ * (six slices each), where the schedule is renormalized to its original sum, i.e., the total time of a game is fixed
+ * and only its allocation is tuned; in each iteration, the parameters are perturbed by +c and -c in random directions,
+ * and the two players play the game pairs with swapped colors in parallel, then the parameters step along the gradient
+ * estimated by the score difference; the configuration is written after each iteration, and is loaded by option config
+ *
+ * options: iteration, pair (the game pairs per iteration), thread, a and c (the gains of SPSA), output (the file)
+ */
+template<class board_type>
+class spsa_tuner {
+public:
+	static constexpr int phases = 6;
+
+	spsa_tuner(const std::string& base, const std::string& args = "")
+		: base(base), iterations(100), pairs(8), threads(1), a(0.1), c(0.2), output("tuned.conf") {
+		std::map<std::string, std::string> meta = parse_options(args);
+		if (meta.count("iteration")) iterations = std::stoi(meta["iteration"]);
+		if (meta.count("pair")) pairs = std::max(std::stoi(meta["pair"]), 1);
+		if (meta.count("thread")) threads = std::max(std::stoi(meta["thread"]), 1);
+		if (meta.count("a")) a = std::stod(meta["a"]);
+		if (meta.count("c")) c = std::stod(meta["c"]);
+		if (meta.count("output")) output = meta["output"];
+
+		player<board_type> initial(base + " role=black");
+		schedule = initial.schedule();
+		theta.assign(1 + phases, 0);
+		theta[0] = std::log(initial.exploration());
+	}
+
+	/* run the iterations, and return the tuned configuration */
+	std::string run() {
+		xoshiro256 engine{ std::random_device()() };
+		for (int k = 0; k < iterations; k++) {
+			double ak = a / std::pow(k + 1 + iterations / 10.0, 0.602), ck = c / std::pow(k + 1, 0.101);
+			std::vector<double> delta(theta.size()), plus(theta), minus(theta);
+			for (size_t i = 0; i < theta.size(); i++) {
+				delta[i] = engine.bounded(2) ? 1 : -1;
+				plus[i] += ck * delta[i], minus[i] -= ck * delta[i];
+			}
+			int score = compare(config(plus), config(minus), engine());
+			double gradient = double(score) / (2 * pairs) / (2 * ck);
+			for (size_t i = 0; i < theta.size(); i++)
+				theta[i] += ak * gradient * delta[i];
+
+			std::ofstream out(output, std::ios::out | std::ios::trunc);
+			out << config(theta) << std::endl;
+			std::cout << (k + 1) << "\t" << "score = " << (score > 0 ? "+" : "") << score << "/" << (2 * pairs) << ", "
+			          << config(theta) << std::endl;
+		}
+		return config(theta);
+	}
+
+	/* the options of the parameters, e.g., "uct=0.5 schedule=0.1,0.1,..." */
+	std::string config(const std::vector<double>& x) const {
+		std::vector<double> slices(schedule);
+		double before = 0, after = 0;
+		for (double t : slices) before += t;
+		for (size_t i = 0; i < slices.size(); i++) {
+			slices[i] *= std::exp(x[1 + i * phases / slices.size()]);
+			after += slices[i];
+		}
+		std::stringstream buf;
+		buf << "uct=" << std::exp(x[0]) << " schedule=";
+		for (size_t i = 0; i < slices.size(); i++)
+			buf << (i ? "," : "") << slices[i] * before / after;
+		return buf.str();
+	}
+
+protected:
+	/* play the game pairs of the configurations in parallel, and return the wins of the first minus its losses */
+	int compare(const std::string& first, const std::string& second, uint64_t seed) {
+		std::atomic<int> next{0}, score{0};
+		run_threads(threads, [&](int t) {
+			for (int g; (g = next++) < pairs; ) {
+				auto meta = [&](const std::string& args, const std::string& role, int n) {
+					return "seed=" + std::to_string(seed + g * 4 + n) + " " + base + " " + args + " role=" + role;
+				};
+				player<board_type> a_black(meta(first, "black", 0)), a_white(meta(first, "white", 1));
+				player<board_type> b_black(meta(second, "black", 2)), b_white(meta(second, "white", 3));
+				score += (match<board_type>::play(a_black, b_white) == board::black) ? 1 : -1;
+				score += (match<board_type>::play(b_black, a_white) == board::white) ? 1 : -1;
+			}
+		});
+		return score;
+	}
+
+private:
+	std::string base;
+	int iterations, pairs, threads;
+	double a, c;
+	std::string output;
+	std::vector<double> schedule;
+	std::vector<double> theta;
+};
+
+template<class board_type> constexpr int spsa_tuner<board_type>::phases;